@@ -0,0 +1,87 @@
+#pragma once
+#include <cmath>
+#include <algorithm>
+#include "vector.h"
+
+// View frustum planes and box tests used for CPU side culling
+namespace Math
+{
+    // Planes as (nx, ny, nz, d) with unit normals, a point p is inside when dot(n, p) + d >= 0
+    struct Frustum
+    {
+        Vector4 planes[6];
+    };
+
+    // Extracts the planes from a column major view projection matrix (OpenGL clip space)
+    inline Frustum ExtractFrustum(const float* m)
+    {
+        auto row = [m](int r) { return Vector4(m[r], m[4 + r], m[8 + r], m[12 + r]); };
+        const Vector4 r0 = row(0);
+        const Vector4 r1 = row(1);
+        const Vector4 r2 = row(2);
+        const Vector4 r3 = row(3);
+
+        Frustum f;
+        f.planes[0] = r3 + r0; // Left
+        f.planes[1] = r3 - r0; // Right
+        f.planes[2] = r3 + r1; // Bottom
+        f.planes[3] = r3 - r1; // Top
+        f.planes[4] = r3 + r2; // Near
+        f.planes[5] = r3 - r2; // Far
+
+        for(Vector4& p : f.planes)
+        {
+            float l = std::sqrt(p.x * p.x + p.y * p.y + p.z * p.z);
+            if(l > 0.0f) p = p / Vector4(l, l, l, l);
+        }
+        return f;
+    }
+
+    // True when the box lies entirely behind one of the planes (conservative, might keep some boxes outside)
+    inline bool AabbOutsideFrustum(const Frustum& f, const Vector3& min, const Vector3& max)
+    {
+        for(const Vector4& p : f.planes)
+        {
+            // The box corner furthest along the plane normal
+            float x = p.x >= 0.0f ? max.x : min.x;
+            float y = p.y >= 0.0f ? max.y : min.y;
+            float z = p.z >= 0.0f ? max.z : min.z;
+            if(p.x * x + p.y * y + p.z * z + p.w < 0.0f) return true;
+        }
+        return false;
+    }
+
+    // True when the box lies entirely in front of every plane
+    inline bool AabbInsideFrustum(const Frustum& f, const Vector3& min, const Vector3& max)
+    {
+        for(const Vector4& p : f.planes)
+        {
+            // The box corner nearest along the plane normal
+            float x = p.x >= 0.0f ? min.x : max.x;
+            float y = p.y >= 0.0f ? min.y : max.y;
+            float z = p.z >= 0.0f ? min.z : max.z;
+            if(p.x * x + p.y * y + p.z * z + p.w < 0.0f) return false;
+        }
+        return true;
+    }
+
+    inline bool SphereOutsideFrustum(const Frustum& f, const Vector3& center, float radius)
+    {
+        for(const Vector4& p : f.planes)
+        {
+            if(p.x * center.x + p.y * center.y + p.z * center.z + p.w < -radius) return true;
+        }
+        return false;
+    }
+
+    inline float AabbDistanceSquared(const Vector3& point, const Vector3& min, const Vector3& max)
+    {
+        float d2 = 0.0f;
+        for(int c = 0; c < 3; c++)
+        {
+            float d = std::max(min.data[c] - point.data[c], 0.0f) + std::max(point.data[c] - max.data[c], 0.0f);
+            d2 += d * d;
+        }
+        return d2;
+    }
+}
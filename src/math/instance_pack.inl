@@ -0,0 +1,103 @@
+#pragma once
+#include <immintrin.h>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include "list_ops.inl"
+
+// SIMD packing of per instance attributes into their compact GPU formats
+namespace Math
+{
+    // Instances converted per loop iteration
+    constexpr size_t INSTANCE_PACK_BATCH = 8;
+
+    inline uint8_t PackUnorm8(float v)
+    {
+        // Round to nearest even, same as _mm_cvtps_epi32
+        return (uint8_t)std::nearbyint(std::min(std::max(v, 0.0f), 1.0f) * 255.0f);
+    }
+
+    // RGBA float colors in [0, 1] to normalized RGBA8
+    inline void PackColorsRGBA8(const float* rgba, uint8_t* out, size_t count)
+    {
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 scale = _mm_set1_ps(255.0f);
+
+        auto convert = [&](const float* p) {
+            __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(p), zero), one);
+            return _mm_cvtps_epi32(_mm_mul_ps(v, scale));
+        };
+
+        size_t i = 0;
+        for(; i + INSTANCE_PACK_BATCH <= count; i += INSTANCE_PACK_BATCH)
+        {
+            const float* p = rgba + i * 4;
+            __m128i c01 = _mm_packs_epi32(convert(p +  0), convert(p +  4));
+            __m128i c23 = _mm_packs_epi32(convert(p +  8), convert(p + 12));
+            __m128i c45 = _mm_packs_epi32(convert(p + 16), convert(p + 20));
+            __m128i c67 = _mm_packs_epi32(convert(p + 24), convert(p + 28));
+            _mm_storeu_si128((__m128i*)(out + i * 4),      _mm_packus_epi16(c01, c23));
+            _mm_storeu_si128((__m128i*)(out + i * 4 + 16), _mm_packus_epi16(c45, c67));
+        }
+
+        for(; i < count; i++)
+        {
+            for(size_t c = 0; c < 4; c++)
+            {
+                out[i * 4 + c] = PackUnorm8(rgba[i * 4 + c]);
+            }
+        }
+    }
+
+    // xyz float positions to 16 bit xyzw (w = 0): q = round((p - origin) * scale) clamped to [0, 65535]
+    inline void QuantizePositions16(const float* xyz, const float* origin, const float* scale, uint16_t* out, size_t count)
+    {
+        constexpr size_t N = INSTANCE_PACK_BATCH * 3;
+        constexpr size_t L = sizeof(Simd::Float) / sizeof(float);
+        static_assert(N % L == 0, "The batch must fill whole SIMD registers.");
+
+        // Period 3 patterns spanning the whole batch
+        float originPattern[N], scalePattern[N], q[N];
+        for(size_t k = 0; k < N; k++)
+        {
+            originPattern[k] = origin[k % 3];
+            scalePattern[k] = scale[k % 3];
+        }
+
+        const Simd::Float zero = Simd::Set1F(0.0f);
+        const Simd::Float half = Simd::Set1F(0.5f);
+        const Simd::Float maxq = Simd::Set1F(65535.0f);
+
+        size_t i = 0;
+        for(; i + INSTANCE_PACK_BATCH <= count; i += INSTANCE_PACK_BATCH)
+        {
+            const float* p = xyz + i * 3;
+            for(size_t k = 0; k < N; k += L)
+            {
+                Simd::Float v = Simd::MulF(Simd::SubF(Simd::LoadF(p + k), Simd::LoadF(originPattern + k)), Simd::LoadF(scalePattern + k));
+                v = Simd::MinF(Simd::MaxF(Simd::AddF(v, half), zero), maxq);
+                Simd::StoreF(q + k, v);
+            }
+
+            uint16_t* o = out + i * 4;
+            for(size_t j = 0; j < INSTANCE_PACK_BATCH; j++)
+            {
+                o[j * 4 + 0] = (uint16_t)q[j * 3 + 0];
+                o[j * 4 + 1] = (uint16_t)q[j * 3 + 1];
+                o[j * 4 + 2] = (uint16_t)q[j * 3 + 2];
+                o[j * 4 + 3] = 0;
+            }
+        }
+
+        for(; i < count; i++)
+        {
+            for(size_t c = 0; c < 3; c++)
+            {
+                float v = (xyz[i * 3 + c] - origin[c]) * scale[c] + 0.5f;
+                out[i * 4 + c] = (uint16_t)std::min(std::max(v, 0.0f), 65535.0f);
+            }
+            out[i * 4 + 3] = 0;
+        }
+    }
+}
@@ -0,0 +1,449 @@
+#pragma once
+#include <immintrin.h>
+#include <type_traits>
+#include <limits>
+#include <cstdint>
+#include "vector.h"
+
+// SIMD kernels over raw list storage
+// Vector lists are processed as flat float streams (VectorN is N packed floats)
+// AVX/AVX2 paths are used when the compiler targets them, SSE2 otherwise
+namespace Math
+{
+    enum class BinaryOp
+    {
+        ADD,
+        SUB,
+        MUL,
+        DIV
+    };
+
+    enum class ReduceOp
+    {
+        SUM,
+        MIN,
+        MAX
+    };
+
+    template<typename T> struct ListElementTraits;
+    template<> struct ListElementTraits<float>        { using Scalar = float;        static constexpr size_t Components = 1; };
+    template<> struct ListElementTraits<int>          { using Scalar = int;          static constexpr size_t Components = 1; };
+    template<> struct ListElementTraits<unsigned int> { using Scalar = unsigned int; static constexpr size_t Components = 1; };
+    template<> struct ListElementTraits<Vector2>      { using Scalar = float;        static constexpr size_t Components = 2; };
+    template<> struct ListElementTraits<Vector3>      { using Scalar = float;        static constexpr size_t Components = 3; };
+    template<> struct ListElementTraits<Vector4>      { using Scalar = float;        static constexpr size_t Components = 4; };
+
+    namespace Simd
+    {
+        // Comparisons give all ones lanes (false for NaN), SelectF picks a where the mask is set
+#if defined(__AVX__)
+        using Float = __m256;
+        constexpr size_t FloatWidth = 8;
+        inline Float LoadF(const float* p)     { return _mm256_loadu_ps(p); }
+        inline void  StoreF(float* p, Float v) { _mm256_storeu_ps(p, v); }
+        inline Float Set1F(float v)            { return _mm256_set1_ps(v); }
+        inline Float AddF(Float a, Float b)    { return _mm256_add_ps(a, b); }
+        inline Float SubF(Float a, Float b)    { return _mm256_sub_ps(a, b); }
+        inline Float MulF(Float a, Float b)    { return _mm256_mul_ps(a, b); }
+        inline Float DivF(Float a, Float b)    { return _mm256_div_ps(a, b); }
+        inline Float MinF(Float a, Float b)    { return _mm256_min_ps(a, b); }
+        inline Float MaxF(Float a, Float b)    { return _mm256_max_ps(a, b); }
+        inline Float AndF(Float a, Float b)    { return _mm256_and_ps(a, b); }
+        inline Float CmpLeF(Float a, Float b)  { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+        inline Float CmpGeF(Float a, Float b)  { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+        inline int   MaskF(Float m)            { return _mm256_movemask_ps(m); }
+        inline Float SelectF(Float m, Float a, Float b) { return _mm256_blendv_ps(b, a, m); }
+#else
+        using Float = __m128;
+        constexpr size_t FloatWidth = 4;
+        inline Float LoadF(const float* p)     { return _mm_loadu_ps(p); }
+        inline void  StoreF(float* p, Float v) { _mm_storeu_ps(p, v); }
+        inline Float Set1F(float v)            { return _mm_set1_ps(v); }
+        inline Float AddF(Float a, Float b)    { return _mm_add_ps(a, b); }
+        inline Float SubF(Float a, Float b)    { return _mm_sub_ps(a, b); }
+        inline Float MulF(Float a, Float b)    { return _mm_mul_ps(a, b); }
+        inline Float DivF(Float a, Float b)    { return _mm_div_ps(a, b); }
+        inline Float MinF(Float a, Float b)    { return _mm_min_ps(a, b); }
+        inline Float MaxF(Float a, Float b)    { return _mm_max_ps(a, b); }
+        inline Float AndF(Float a, Float b)    { return _mm_and_ps(a, b); }
+        inline Float CmpLeF(Float a, Float b)  { return _mm_cmple_ps(a, b); }
+        inline Float CmpGeF(Float a, Float b)  { return _mm_cmpge_ps(a, b); }
+        inline int   MaskF(Float m)            { return _mm_movemask_ps(m); }
+        inline Float SelectF(Float m, Float a, Float b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+#endif
+
+#if defined(__AVX2__)
+        using Int = __m256i;
+        constexpr size_t IntWidth = 8;
+        inline Int  LoadI(const void* p)   { return _mm256_loadu_si256((const __m256i*)p); }
+        inline void StoreI(void* p, Int v) { _mm256_storeu_si256((__m256i*)p, v); }
+        inline Int  AddI(Int a, Int b)     { return _mm256_add_epi32(a, b); }
+        inline Int  SubI(Int a, Int b)     { return _mm256_sub_epi32(a, b); }
+        inline Int  MulI(Int a, Int b)     { return _mm256_mullo_epi32(a, b); }
+        inline Int  Set1I(int v)           { return _mm256_set1_epi32(v); }
+        inline Int  MinI(Int a, Int b)     { return _mm256_min_epi32(a, b); }
+        inline Int  MaxI(Int a, Int b)     { return _mm256_max_epi32(a, b); }
+        inline Int  MinU(Int a, Int b)     { return _mm256_min_epu32(a, b); }
+        inline Int  MaxU(Int a, Int b)     { return _mm256_max_epu32(a, b); }
+#else
+        using Int = __m128i;
+        constexpr size_t IntWidth = 4;
+        inline Int  LoadI(const void* p)   { return _mm_loadu_si128((const __m128i*)p); }
+        inline void StoreI(void* p, Int v) { _mm_storeu_si128((__m128i*)p, v); }
+        inline Int  AddI(Int a, Int b)     { return _mm_add_epi32(a, b); }
+        inline Int  SubI(Int a, Int b)     { return _mm_sub_epi32(a, b); }
+        inline Int  MulI(Int a, Int b)
+        {
+            // SSE2 has no 32 bit low multiply, build it from the two 32x32->64 bit ones
+            // The low 32 bits are the same for signed and unsigned operands
+            Int even = _mm_mul_epu32(a, b);
+            Int odd  = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+            return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+        }
+        inline Int  Set1I(int v)           { return _mm_set1_epi32(v); }
+
+        // SSE2 only compares signed lanes, unsigned ones are compared with their sign bit flipped
+        inline Int  SelectGtI(Int a, Int b, Int x, Int y)
+        {
+            Int m = _mm_cmpgt_epi32(a, b);
+            return _mm_or_si128(_mm_and_si128(m, x), _mm_andnot_si128(m, y));
+        }
+        inline Int  MinI(Int a, Int b)     { return SelectGtI(a, b, b, a); }
+        inline Int  MaxI(Int a, Int b)     { return SelectGtI(a, b, a, b); }
+        inline Int  MinU(Int a, Int b)
+        {
+            Int s = _mm_set1_epi32(INT32_MIN);
+            return SelectGtI(_mm_xor_si128(a, s), _mm_xor_si128(b, s), b, a);
+        }
+        inline Int  MaxU(Int a, Int b)
+        {
+            Int s = _mm_set1_epi32(INT32_MIN);
+            return SelectGtI(_mm_xor_si128(a, s), _mm_xor_si128(b, s), a, b);
+        }
+#endif
+    }
+
+    namespace Detail
+    {
+        template<BinaryOp OP, typename S>
+        inline S ScalarOp(S a, S b)
+        {
+                 if constexpr(OP == BinaryOp::ADD) return a + b;
+            else if constexpr(OP == BinaryOp::SUB) return a - b;
+            else if constexpr(OP == BinaryOp::MUL) return a * b;
+            else if constexpr(std::is_integral_v<S>) return b != 0 ? a / b : S(0); // Do not crash on integer division by zero
+            else return a / b;
+        }
+
+        // Lane loaders for each scalar type
+        template<typename S> struct Lanes;
+        template<> struct Lanes<float>
+        {
+            using Vec = Simd::Float;
+            static constexpr size_t Width = Simd::FloatWidth;
+            static inline Vec  Load(const float* p)  { return Simd::LoadF(p); }
+            static inline void Store(float* p, Vec v) { Simd::StoreF(p, v); }
+            static inline Vec  Set1(float v)          { return Simd::Set1F(v); }
+        };
+        template<> struct Lanes<int>
+        {
+            using Vec = Simd::Int;
+            static constexpr size_t Width = Simd::IntWidth;
+            static inline Vec  Load(const int* p)  { return Simd::LoadI(p); }
+            static inline void Store(int* p, Vec v) { Simd::StoreI(p, v); }
+            static inline Vec  Set1(int v)          { return Simd::Set1I(v); }
+        };
+        template<> struct Lanes<unsigned int>
+        {
+            using Vec = Simd::Int;
+            static constexpr size_t Width = Simd::IntWidth;
+            static inline Vec  Load(const unsigned int* p)  { return Simd::LoadI(p); }
+            static inline void Store(unsigned int* p, Vec v) { Simd::StoreI(p, v); }
+            static inline Vec  Set1(unsigned int v)          { return Simd::Set1I((int)v); }
+        };
+
+        // There is no integer SIMD division, those fall back to the scalar loop
+        template<BinaryOp OP, typename S>
+        constexpr bool HasVecOp = std::is_floating_point_v<S> || OP != BinaryOp::DIV;
+
+        template<BinaryOp OP>
+        inline Simd::Float VecOp(Simd::Float a, Simd::Float b)
+        {
+                 if constexpr(OP == BinaryOp::ADD) return Simd::AddF(a, b);
+            else if constexpr(OP == BinaryOp::SUB) return Simd::SubF(a, b);
+            else if constexpr(OP == BinaryOp::MUL) return Simd::MulF(a, b);
+            else return Simd::DivF(a, b);
+        }
+
+        template<BinaryOp OP>
+        inline Simd::Int VecOp(Simd::Int a, Simd::Int b)
+        {
+                 if constexpr(OP == BinaryOp::ADD) return Simd::AddI(a, b);
+            else if constexpr(OP == BinaryOp::SUB) return Simd::SubI(a, b);
+            else return Simd::MulI(a, b);
+        }
+
+        template<ReduceOp OP, typename S>
+        inline S ReduceIdentity()
+        {
+                 if constexpr(OP == ReduceOp::SUM) return S(0);
+            else if constexpr(OP == ReduceOp::MIN) return std::numeric_limits<S>::has_infinity ?  std::numeric_limits<S>::infinity() : std::numeric_limits<S>::max();
+            else                                   return std::numeric_limits<S>::has_infinity ? -std::numeric_limits<S>::infinity() : std::numeric_limits<S>::lowest();
+        }
+
+        template<ReduceOp OP, typename S>
+        inline S ScalarReduce(S a, S b)
+        {
+                 if constexpr(OP == ReduceOp::SUM) return a + b;
+            else if constexpr(OP == ReduceOp::MIN) return b < a ? b : a;
+            else                                   return b > a ? b : a;
+        }
+
+        // Integer lanes wrap on overflow like the scalar sums
+        template<ReduceOp OP, typename S>
+        inline typename Lanes<S>::Vec VecReduce(typename Lanes<S>::Vec a, typename Lanes<S>::Vec b)
+        {
+            if constexpr(std::is_same_v<S, float>)
+            {
+                     if constexpr(OP == ReduceOp::SUM) return Simd::AddF(a, b);
+                else if constexpr(OP == ReduceOp::MIN) return Simd::MinF(a, b);
+                else                                   return Simd::MaxF(a, b);
+            }
+            else if constexpr(std::is_signed_v<S>)
+            {
+                     if constexpr(OP == ReduceOp::SUM) return Simd::AddI(a, b);
+                else if constexpr(OP == ReduceOp::MIN) return Simd::MinI(a, b);
+                else                                   return Simd::MaxI(a, b);
+            }
+            else
+            {
+                     if constexpr(OP == ReduceOp::SUM) return Simd::AddI(a, b);
+                else if constexpr(OP == ReduceOp::MIN) return Simd::MinU(a, b);
+                else                                   return Simd::MaxU(a, b);
+            }
+        }
+
+        // Common multiple of every period (1 to 4) and every lane width
+        constexpr size_t PATTERN_BLOCK = 24;
+    }
+
+    // out[i] = a[i] OP b[i]
+    template<BinaryOp OP, typename S>
+    inline void StreamOp(const S* a, const S* b, S* out, size_t count)
+    {
+        size_t i = 0;
+        if constexpr(Detail::HasVecOp<OP, S>)
+        {
+            using L = Detail::Lanes<S>;
+            for(; i + L::Width <= count; i += L::Width)
+            {
+                L::Store(out + i, Detail::VecOp<OP>(L::Load(a + i), L::Load(b + i)));
+            }
+        }
+        for(; i < count; i++)
+        {
+            out[i] = Detail::ScalarOp<OP>(a[i], b[i]);
+        }
+    }
+
+    // out[i] = a[i] OP pattern[i % period] (or pattern[i % period] OP a[i] if REVERSED)
+    // a must start at a pattern boundary, period must be 1, 2, 3 or 4
+    template<BinaryOp OP, bool REVERSED, typename S>
+    inline void StreamOpBroadcast(const S* a, const S* pattern, size_t period, S* out, size_t count)
+    {
+        constexpr size_t BLOCK = Detail::PATTERN_BLOCK;
+
+        alignas(32) S block[BLOCK];
+        for(size_t k = 0; k < BLOCK; k++)
+        {
+            block[k] = pattern[k % period];
+        }
+
+        size_t i = 0;
+        if constexpr(Detail::HasVecOp<OP, S>)
+        {
+            using L = Detail::Lanes<S>;
+            for(; i + BLOCK <= count; i += BLOCK)
+            {
+                for(size_t j = 0; j < BLOCK; j += L::Width)
+                {
+                    auto va = L::Load(a + i + j);
+                    auto vb = L::Load(block + j);
+                    if constexpr(REVERSED) L::Store(out + i + j, Detail::VecOp<OP>(vb, va));
+                    else                   L::Store(out + i + j, Detail::VecOp<OP>(va, vb));
+                }
+            }
+        }
+        for(; i < count; i++)
+        {
+            if constexpr(REVERSED) out[i] = Detail::ScalarOp<OP>(block[i % BLOCK], a[i]);
+            else                   out[i] = Detail::ScalarOp<OP>(a[i], block[i % BLOCK]);
+        }
+    }
+
+    // Runtime op dispatch for the kernels above
+    template<typename S>
+    inline void ListBinaryOp(BinaryOp op, const S* a, const S* b, S* out, size_t count)
+    {
+        switch (op)
+        {
+            case BinaryOp::ADD: StreamOp<BinaryOp::ADD>(a, b, out, count); break;
+            case BinaryOp::SUB: StreamOp<BinaryOp::SUB>(a, b, out, count); break;
+            case BinaryOp::MUL: StreamOp<BinaryOp::MUL>(a, b, out, count); break;
+            case BinaryOp::DIV: StreamOp<BinaryOp::DIV>(a, b, out, count); break;
+        }
+    }
+
+    template<typename S>
+    inline void ListBroadcastOp(BinaryOp op, bool reversed, const S* a, const S* pattern, size_t period, S* out, size_t count)
+    {
+        if(reversed)
+        {
+            switch (op)
+            {
+                case BinaryOp::ADD: StreamOpBroadcast<BinaryOp::ADD, true>(a, pattern, period, out, count); break;
+                case BinaryOp::SUB: StreamOpBroadcast<BinaryOp::SUB, true>(a, pattern, period, out, count); break;
+                case BinaryOp::MUL: StreamOpBroadcast<BinaryOp::MUL, true>(a, pattern, period, out, count); break;
+                case BinaryOp::DIV: StreamOpBroadcast<BinaryOp::DIV, true>(a, pattern, period, out, count); break;
+            }
+        }
+        else
+        {
+            switch (op)
+            {
+                case BinaryOp::ADD: StreamOpBroadcast<BinaryOp::ADD, false>(a, pattern, period, out, count); break;
+                case BinaryOp::SUB: StreamOpBroadcast<BinaryOp::SUB, false>(a, pattern, period, out, count); break;
+                case BinaryOp::MUL: StreamOpBroadcast<BinaryOp::MUL, false>(a, pattern, period, out, count); break;
+                case BinaryOp::DIV: StreamOpBroadcast<BinaryOp::DIV, false>(a, pattern, period, out, count); break;
+            }
+        }
+    }
+
+    // out[c] = out[c] OP a[c] OP a[c + period] OP a[c + 2 * period] ...
+    // out must hold period values and is accumulated into (initialize it with the op identity)
+    // a must start at a pattern boundary, period must be 1, 2, 3 or 4
+    template<ReduceOp OP, typename S>
+    inline void StreamReduce(const S* a, size_t period, size_t count, S* out)
+    {
+        constexpr size_t BLOCK = Detail::PATTERN_BLOCK;
+
+        size_t i = 0;
+        {
+            // One accumulator per lane of the block, folded per component at the end
+            using L = Detail::Lanes<S>;
+            constexpr size_t W = L::Width;
+            typename L::Vec acc[BLOCK / W];
+            for(size_t j = 0; j < BLOCK / W; j++)
+            {
+                acc[j] = L::Set1(Detail::ReduceIdentity<OP, S>());
+            }
+
+            for(; i + BLOCK <= count; i += BLOCK)
+            {
+                for(size_t j = 0; j < BLOCK / W; j++)
+                {
+                    acc[j] = Detail::VecReduce<OP, S>(acc[j], L::Load(a + i + j * W));
+                }
+            }
+
+            alignas(32) S lanes[BLOCK];
+            for(size_t j = 0; j < BLOCK / W; j++)
+            {
+                L::Store(lanes + j * W, acc[j]);
+            }
+            for(size_t k = 0; k < BLOCK; k++)
+            {
+                out[k % period] = Detail::ScalarReduce<OP>(out[k % period], lanes[k]);
+            }
+        }
+
+        for(; i < count; i += period)
+        {
+            for(size_t c = 0; c < period; c++)
+            {
+                out[c] = Detail::ScalarReduce<OP>(out[c], a[i + c]);
+            }
+        }
+    }
+
+    // StreamReduce() for MIN and MAX at the same time (a single pass over the data)
+    template<typename S>
+    inline void StreamMinMax(const S* a, size_t period, size_t count, S* outMin, S* outMax)
+    {
+        constexpr size_t BLOCK = Detail::PATTERN_BLOCK;
+
+        size_t i = 0;
+        {
+            using L = Detail::Lanes<S>;
+            constexpr size_t W = L::Width;
+            typename L::Vec accMin[BLOCK / W];
+            typename L::Vec accMax[BLOCK / W];
+            for(size_t j = 0; j < BLOCK / W; j++)
+            {
+                accMin[j] = L::Set1(Detail::ReduceIdentity<ReduceOp::MIN, S>());
+                accMax[j] = L::Set1(Detail::ReduceIdentity<ReduceOp::MAX, S>());
+            }
+
+            for(; i + BLOCK <= count; i += BLOCK)
+            {
+                for(size_t j = 0; j < BLOCK / W; j++)
+                {
+                    typename L::Vec v = L::Load(a + i + j * W);
+                    accMin[j] = Detail::VecReduce<ReduceOp::MIN, S>(accMin[j], v);
+                    accMax[j] = Detail::VecReduce<ReduceOp::MAX, S>(accMax[j], v);
+                }
+            }
+
+            alignas(32) S lanesMin[BLOCK];
+            alignas(32) S lanesMax[BLOCK];
+            for(size_t j = 0; j < BLOCK / W; j++)
+            {
+                L::Store(lanesMin + j * W, accMin[j]);
+                L::Store(lanesMax + j * W, accMax[j]);
+            }
+            for(size_t k = 0; k < BLOCK; k++)
+            {
+                outMin[k % period] = Detail::ScalarReduce<ReduceOp::MIN>(outMin[k % period], lanesMin[k]);
+                outMax[k % period] = Detail::ScalarReduce<ReduceOp::MAX>(outMax[k % period], lanesMax[k]);
+            }
+        }
+
+        for(; i < count; i += period)
+        {
+            for(size_t c = 0; c < period; c++)
+            {
+                outMin[c] = Detail::ScalarReduce<ReduceOp::MIN>(outMin[c], a[i + c]);
+                outMax[c] = Detail::ScalarReduce<ReduceOp::MAX>(outMax[c], a[i + c]);
+            }
+        }
+    }
+
+    // Per component running sum, starting from carry[period] (updated with the final sums)
+    // INCLUSIVE: out[i] = carry + a[0] + ... + a[i], otherwise out[i] = carry + a[0] + ... + a[i - 1]
+    template<bool INCLUSIVE, typename S>
+    inline void StreamScan(const S* a, size_t period, size_t count, S* carry, S* out)
+    {
+        S run[4];
+        for(size_t c = 0; c < period; c++) run[c] = carry[c];
+
+        for(size_t i = 0; i < count; i += period)
+        {
+            for(size_t c = 0; c < period; c++)
+            {
+                const S v = a[i + c];
+                if constexpr(INCLUSIVE)
+                {
+                    run[c] += v;
+                    out[i + c] = run[c];
+                }
+                else
+                {
+                    out[i + c] = run[c];
+                    run[c] += v;
+                }
+            }
+        }
+
+        for(size_t c = 0; c < period; c++) carry[c] = run[c];
+    }
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "list_ops.inl"
+#include "../util/parallel.inl"
+
+// Multithreaded reductions and scans over raw list storage
+// Each thread reduces its own chunk with the SIMD kernels, the per chunk partials are then combined
+namespace Math
+{
+    // Below this many scalars per thread the reductions run single threaded
+    constexpr size_t REDUCE_MIN_SCALARS_PER_THREAD = 1 << 17;
+
+    inline size_t GetReduceChunkCount(size_t elementCount, size_t period)
+    {
+        return Utils::GetParallelChunkCount(elementCount, REDUCE_MIN_SCALARS_PER_THREAD / period);
+    }
+
+    // out[c] = OP over the component c of elementCount elements with period components each
+    template<ReduceOp OP, typename S>
+    inline void ParallelReduce(const S* a, size_t period, size_t elementCount, S* out)
+    {
+        std::array<S, 4> identity;
+        identity.fill(Detail::ReduceIdentity<OP, S>());
+
+        const size_t chunks = GetReduceChunkCount(elementCount, period);
+        std::vector<std::array<S, 4>> partials(chunks, identity);
+
+        Utils::ParallelForChunks(elementCount, chunks, [&](size_t chunk, size_t begin, size_t end) {
+            StreamReduce<OP>(a + begin * period, period, (end - begin) * period, partials[chunk].data());
+        });
+
+        for(size_t c = 0; c < period; c++)
+        {
+            out[c] = identity[c];
+            for(const auto& p : partials)
+            {
+                out[c] = Detail::ScalarReduce<OP>(out[c], p[c]);
+            }
+        }
+    }
+
+    // Component wise sum of integer elements in 64 bits, for means of lists whose sum overflows S
+    template<typename S>
+    inline void ParallelWideSum(const S* a, size_t period, size_t elementCount, double* out)
+    {
+        using W = std::conditional_t<std::is_signed_v<S>, int64_t, uint64_t>;
+
+        const size_t chunks = GetReduceChunkCount(elementCount, period);
+        std::vector<std::array<W, 4>> partials(chunks, { 0, 0, 0, 0 });
+
+        Utils::ParallelForChunks(elementCount, chunks, [&](size_t chunk, size_t begin, size_t end) {
+            std::array<W, 4>& sum = partials[chunk];
+            for(size_t i = begin; i < end; i++)
+            {
+                for(size_t c = 0; c < period; c++) sum[c] += (W)a[i * period + c];
+            }
+        });
+
+        for(size_t c = 0; c < period; c++)
+        {
+            W sum = 0;
+            for(const auto& p : partials) sum += p[c];
+            out[c] = (double)sum;
+        }
+    }
+
+    // Component wise bounds of elementCount elements (AABB for vector lists)
+    template<typename S>
+    inline void ParallelMinMax(const S* a, size_t period, size_t elementCount, S* outMin, S* outMax)
+    {
+        std::array<S, 4> idMin, idMax;
+        idMin.fill(Detail::ReduceIdentity<ReduceOp::MIN, S>());
+        idMax.fill(Detail::ReduceIdentity<ReduceOp::MAX, S>());
+
+        const size_t chunks = GetReduceChunkCount(elementCount, period);
+        std::vector<std::array<S, 4>> partialsMin(chunks, idMin);
+        std::vector<std::array<S, 4>> partialsMax(chunks, idMax);
+
+        Utils::ParallelForChunks(elementCount, chunks, [&](size_t chunk, size_t begin, size_t end) {
+            StreamMinMax(a + begin * period, period, (end - begin) * period, partialsMin[chunk].data(), partialsMax[chunk].data());
+        });
+
+        for(size_t c = 0; c < period; c++)
+        {
+            outMin[c] = idMin[c];
+            outMax[c] = idMax[c];
+            for(size_t k = 0; k < chunks; k++)
+            {
+                outMin[c] = Detail::ScalarReduce<ReduceOp::MIN>(outMin[c], partialsMin[k][c]);
+                outMax[c] = Detail::ScalarReduce<ReduceOp::MAX>(outMax[c], partialsMax[k][c]);
+            }
+        }
+    }
+
+    // Component wise prefix sum of elementCount elements into out (same layout as a)
+    // Two passes: chunk sums first, then each chunk scans starting from the sum of the chunks before it
+    template<bool INCLUSIVE, typename S>
+    inline void ParallelScan(const S* a, size_t period, size_t elementCount, S* out)
+    {
+        const size_t chunks = GetReduceChunkCount(elementCount, period);
+
+        std::array<S, 4> zero;
+        zero.fill(S(0));
+
+        if(chunks <= 1)
+        {
+            StreamScan<INCLUSIVE>(a, period, elementCount * period, zero.data(), out);
+            return;
+        }
+
+        std::vector<std::array<S, 4>> carry(chunks, zero);
+        Utils::ParallelForChunks(elementCount, chunks, [&](size_t chunk, size_t begin, size_t end) {
+            StreamReduce<ReduceOp::SUM>(a + begin * period, period, (end - begin) * period, carry[chunk].data());
+        });
+
+        // Exclusive scan of the chunk sums
+        std::array<S, 4> run = zero;
+        for(size_t k = 0; k < chunks; k++)
+        {
+            std::array<S, 4> sum = carry[k];
+            carry[k] = run;
+            for(size_t c = 0; c < period; c++) run[c] += sum[c];
+        }
+
+        Utils::ParallelForChunks(elementCount, chunks, [&](size_t chunk, size_t begin, size_t end) {
+            StreamScan<INCLUSIVE>(a + begin * period, period, (end - begin) * period, carry[chunk].data(), out + begin * period);
+        });
+    }
+}
@@ -0,0 +1,150 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include "../util/parallel.inl"
+
+// Parallel LSD radix sort over unsigned integer keys plus key encoders (floats, Morton codes)
+// The sort is stable and carries a permutation along, so any list can be reordered with a gather
+namespace Math
+{
+    // Below this many keys per thread the sort passes run single threaded
+    constexpr size_t RADIX_MIN_ELEMENTS_PER_THREAD = 1 << 15;
+    constexpr unsigned int RADIX_DIGIT_BITS = 8;
+    constexpr size_t RADIX_BUCKETS = 1 << RADIX_DIGIT_BITS;
+
+    // Maps a float to an unsigned key with the same ordering (negatives flipped, positives sign bit set)
+    inline uint32_t FloatToRadixKey(float f)
+    {
+        uint32_t u;
+        memcpy(&u, &f, sizeof(float));
+        return u ^ ((u & 0x80000000u) ? 0xFFFFFFFFu : 0x80000000u);
+    }
+
+    inline uint32_t IntToRadixKey(int i)
+    {
+        return (uint32_t)i ^ 0x80000000u;
+    }
+
+    // Spreads the lower 10 bits of v so there are two zero bits between each
+    inline uint32_t MortonExpandBits10(uint32_t v)
+    {
+        v &= 0x000003FFu;
+        v = (v | (v << 16)) & 0x030000FFu;
+        v = (v | (v <<  8)) & 0x0300F00Fu;
+        v = (v | (v <<  4)) & 0x030C30C3u;
+        v = (v | (v <<  2)) & 0x09249249u;
+        return v;
+    }
+
+    // Spreads the lower 21 bits of v so there are two zero bits between each
+    inline uint64_t MortonExpandBits21(uint64_t v)
+    {
+        v &= 0x00000000001FFFFFull;
+        v = (v | (v << 32)) & 0x001F00000000FFFFull;
+        v = (v | (v << 16)) & 0x001F0000FF0000FFull;
+        v = (v | (v <<  8)) & 0x100F00F00F00F00Full;
+        v = (v | (v <<  4)) & 0x10C30C30C30C30C3ull;
+        v = (v | (v <<  2)) & 0x1249249249249249ull;
+        return v;
+    }
+
+    // x, y and z must already be quantized to 10 bits (30 bit code)
+    inline uint32_t MortonEncode30(uint32_t x, uint32_t y, uint32_t z)
+    {
+        return (MortonExpandBits10(x) << 2) | (MortonExpandBits10(y) << 1) | MortonExpandBits10(z);
+    }
+
+    // x, y and z must already be quantized to 21 bits (63 bit code)
+    inline uint64_t MortonEncode63(uint64_t x, uint64_t y, uint64_t z)
+    {
+        return (MortonExpandBits21(x) << 2) | (MortonExpandBits21(y) << 1) | MortonExpandBits21(z);
+    }
+
+    // Stable ascending sort of keys, applying the same reordering to perm
+    // Only the lower keyBits bits of the keys are considered
+    // Each pass builds per chunk digit histograms in parallel, prefix sums them in (digit, chunk) order and scatters in parallel
+    template<typename K>
+    inline void ParallelRadixSort(std::vector<K>& keys, std::vector<unsigned int>& perm, unsigned int keyBits = sizeof(K) * 8)
+    {
+        const size_t count = keys.size();
+        if(count < 2) return;
+
+        std::vector<K> keysTmp(count);
+        std::vector<unsigned int> permTmp(count);
+
+        K* srcKeys = keys.data();
+        K* dstKeys = keysTmp.data();
+        unsigned int* srcPerm = perm.data();
+        unsigned int* dstPerm = permTmp.data();
+
+        const size_t chunks = Utils::GetParallelChunkCount(count, RADIX_MIN_ELEMENTS_PER_THREAD);
+        std::vector<std::array<size_t, RADIX_BUCKETS>> histograms(chunks);
+
+        for(unsigned int shift = 0; shift < keyBits; shift += RADIX_DIGIT_BITS)
+        {
+            for(auto& h : histograms) h.fill(0);
+
+            Utils::ParallelForChunks(count, chunks, [&](size_t chunk, size_t begin, size_t end) {
+                auto& h = histograms[chunk];
+                for(size_t i = begin; i < end; i++)
+                {
+                    h[(srcKeys[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+                }
+            });
+
+            // Every key has the same digit, the pass would not move anything
+            bool trivial = false;
+            for(size_t d = 0; d < RADIX_BUCKETS && !trivial; d++)
+            {
+                size_t total = 0;
+                for(const auto& h : histograms) total += h[d];
+                trivial = (total == count);
+            }
+            if(trivial) continue;
+
+            size_t offset = 0;
+            for(size_t d = 0; d < RADIX_BUCKETS; d++)
+            {
+                for(auto& h : histograms)
+                {
+                    size_t c = h[d];
+                    h[d] = offset;
+                    offset += c;
+                }
+            }
+
+            Utils::ParallelForChunks(count, chunks, [&](size_t chunk, size_t begin, size_t end) {
+                auto& h = histograms[chunk];
+                for(size_t i = begin; i < end; i++)
+                {
+                    size_t dst = h[(srcKeys[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+                    dstKeys[dst] = srcKeys[i];
+                    dstPerm[dst] = srcPerm[i];
+                }
+            });
+
+            std::swap(srcKeys, dstKeys);
+            std::swap(srcPerm, dstPerm);
+        }
+
+        // An odd number of executed passes leaves the result in the scratch buffers
+        if(srcKeys != keys.data())
+        {
+            keys.swap(keysTmp);
+            perm.swap(permTmp);
+        }
+    }
+
+    // Sorts keys and returns the permutation such that sorted[i] = list[perm[i]]
+    template<typename K>
+    inline std::vector<unsigned int> ParallelRadixSortPermutation(std::vector<K>& keys, unsigned int keyBits = sizeof(K) * 8)
+    {
+        std::vector<unsigned int> perm(keys.size());
+        std::iota(perm.begin(), perm.end(), 0u);
+        ParallelRadixSort(keys, perm, keyBits);
+        return perm;
+    }
+}
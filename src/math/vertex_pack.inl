@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+// Compact mesh vertex formats (as uploaded to the GPU)
+namespace Math
+{
+    // Position as unorm16 inside the mesh bounds (w is padding) and octahedral normal as snorm16x2, 12 bytes
+    struct MeshVertex16
+    {
+        uint16_t x, y, z, w;
+        int16_t  nx, ny;
+    };
+
+    inline int16_t PackSnorm16(float v)
+    {
+        return (int16_t)std::nearbyint(std::min(std::max(v, -1.0f), 1.0f) * 32767.0f);
+    }
+
+    // Unit normal onto the octahedron unfolded in [-1, 1]^2
+    inline void OctEncodeNormal(const float* n, int16_t* out)
+    {
+        const float l1 = std::abs(n[0]) + std::abs(n[1]) + std::abs(n[2]);
+        float x = l1 > 0.0f ? n[0] / l1 : 0.0f;
+        float y = l1 > 0.0f ? n[1] / l1 : 0.0f;
+
+        // Fold the lower hemisphere over the diagonals
+        if(n[2] < 0.0f)
+        {
+            const float fx = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+            const float fy = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+            x = fx;
+            y = fy;
+        }
+
+        out[0] = PackSnorm16(x);
+        out[1] = PackSnorm16(y);
+    }
+
+    // Pos + normal float vertices (6 floats) to MeshVertex16: q = round((p - origin) * scale) clamped to [0, 65535]
+    inline void PackMeshVertices16(const float* vertices, size_t count, const float* origin, const float* scale, MeshVertex16* out)
+    {
+        for(size_t i = 0; i < count; i++)
+        {
+            const float* v = vertices + i * 6;
+            uint16_t* q = &out[i].x;
+            for(size_t c = 0; c < 3; c++)
+            {
+                float p = (v[c] - origin[c]) * scale[c] + 0.5f;
+                q[c] = (uint16_t)std::min(std::max(p, 0.0f), 65535.0f);
+            }
+            out[i].w = 0;
+            OctEncodeNormal(v + 3, &out[i].nx);
+        }
+    }
+}
@@ -0,0 +1,100 @@
+#include "instance_culler.h"
+#include "../util/parallel.inl"
+
+// Below this many chunks per thread culling runs single threaded
+constexpr size_t CULL_MIN_CHUNKS_PER_THREAD = 64;
+
+void RasterRenderer::InstanceCuller::invalidate()
+{
+    _count = 0;
+    _chunkMin.clear();
+    _chunkMax.clear();
+}
+
+void RasterRenderer::InstanceCuller::refresh(const Vector3* positions, unsigned int count, const InstanceDirtyRange& changed)
+{
+    unsigned int begin = changed.begin;
+    unsigned int end = changed.end;
+
+    if(count != _count || _chunkMin.empty())
+    {
+        _count = count;
+        const size_t chunks = (count + INSTANCE_CULL_CHUNK - 1) / INSTANCE_CULL_CHUNK;
+        _chunkMin.resize(chunks);
+        _chunkMax.resize(chunks);
+        begin = 0;
+        end = count;
+    }
+
+    end = std::min(end, count);
+    if(begin >= end) return;
+
+    const size_t first = begin / INSTANCE_CULL_CHUNK;
+    const size_t last = (end - 1) / INSTANCE_CULL_CHUNK + 1;
+
+    Utils::ParallelFor(last - first, CULL_MIN_CHUNKS_PER_THREAD, [&](size_t b, size_t e) {
+        for(size_t c = first + b; c < first + e; c++)
+        {
+            const size_t i0 = c * INSTANCE_CULL_CHUNK;
+            const size_t i1 = std::min<size_t>(i0 + INSTANCE_CULL_CHUNK, count);
+
+            Vector3 min = positions[i0];
+            Vector3 max = positions[i0];
+            for(size_t i = i0 + 1; i < i1; i++)
+            {
+                for(int k = 0; k < 3; k++)
+                {
+                    min.data[k] = std::min(min.data[k], positions[i].data[k]);
+                    max.data[k] = std::max(max.data[k], positions[i].data[k]);
+                }
+            }
+            _chunkMin[c] = min;
+            _chunkMax[c] = max;
+        }
+    });
+}
+
+void RasterRenderer::InstanceCuller::cull(const Vector3* positions, const Math::Frustum& frustum, float radius, std::vector<unsigned int>& visible)
+{
+    visible.clear();
+
+    const size_t chunks = _chunkMin.size();
+    const size_t threads = Utils::GetParallelChunkCount(chunks, CULL_MIN_CHUNKS_PER_THREAD);
+    _threadVisible.resize(threads);
+
+    const Vector3 r = Vector3(radius, radius, radius);
+    const unsigned int count = _count;
+
+    Utils::ParallelForChunks(chunks, threads, [&](size_t thread, size_t begin, size_t end) {
+        std::vector<unsigned int>& out = _threadVisible[thread];
+        out.clear();
+
+        for(size_t c = begin; c < end; c++)
+        {
+            const Vector3 min = _chunkMin[c] - r;
+            const Vector3 max = _chunkMax[c] + r;
+            if(Math::AabbOutsideFrustum(frustum, min, max)) continue;
+
+            const unsigned int i0 = (unsigned int)(c * INSTANCE_CULL_CHUNK);
+            const unsigned int i1 = std::min(i0 + INSTANCE_CULL_CHUNK, count);
+
+            if(Math::AabbInsideFrustum(frustum, min, max))
+            {
+                for(unsigned int i = i0; i < i1; i++) out.push_back(i);
+            }
+            else for(unsigned int i = i0; i < i1; i++)
+            {
+                if(!Math::SphereOutsideFrustum(frustum, positions[i], radius)) out.push_back(i);
+            }
+        }
+    });
+
+    // Chunks are contiguous and in order, so the indices stay sorted
+    size_t total = 0;
+    for(size_t t = 0; t < threads; t++) total += _threadVisible[t].size();
+    visible.reserve(total);
+    for(size_t t = 0; t < threads; t++)
+    {
+        visible.insert(visible.end(), _threadVisible[t].begin(), _threadVisible[t].end());
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <vector>
+#include "../math/vector.h"
+#include "../math/frustum.inl"
+#include "node_outputs.h"
+
+namespace RasterRenderer
+{
+    // Instances per culling chunk
+    constexpr unsigned int INSTANCE_CULL_CHUNK = 256;
+
+    // Frustum culling of instance positions, chunk by chunk
+    // A chunk is a run of consecutive instances with its own bounds, so spatially ordered lists (e.g. Sort Node Morton order) cull best
+    // Chunks fully inside the frustum are kept whole, chunks crossing it are tested instance by instance
+    struct InstanceCuller
+    {
+        // Recomputes the bounds of the chunks overlapping changed (every chunk when the count changes)
+        void refresh(const Vector3* positions, unsigned int count, const InstanceDirtyRange& changed);
+
+        // Forces every chunk to be recomputed on the next refresh
+        void invalidate();
+
+        // Fills visible with the (ascending) indices of the instances whose bounding sphere might be visible
+        void cull(const Vector3* positions, const Math::Frustum& frustum, float radius, std::vector<unsigned int>& visible);
+
+    private:
+        unsigned int _count = 0;
+        std::vector<Vector3> _chunkMin;
+        std::vector<Vector3> _chunkMax;
+        std::vector<std::vector<unsigned int>> _threadVisible;
+    };
+}
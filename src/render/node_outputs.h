@@ -1,15 +1,91 @@
 #pragma once
 #include <vector>
+#include <string>
+#include <cstdint>
+#include <algorithm>
 #include "../math/vector.h"
 #include "../../glm/glm/glm.hpp"
 
 // This file declares custom node output data
 
 // mesh_node.h output
+// Simplified levels of detail per mesh (besides the mesh itself)
+constexpr unsigned int MESH_MAX_LODS = 4;
+
+struct MeshLod
+{
+    size_t first = 0; // Into MeshNodeData::lod_index_data
+    size_t count = 0;
+    float  error = 0.0f; // Object space distance error
+};
+
+struct MeshPrefetchList;
+
+// Vertices are pos + normal (6 floats), indexed by index_data (16 or 32 bit) when index_count > 0
 struct MeshNodeData
 {
-    float* vertex_data = nullptr;
-    size_t data_size = 0;
+    const float* vertex_data = nullptr;
+    size_t       data_size = 0;
+
+    const void*  index_data = nullptr;
+    size_t       index_count = 0;
+    unsigned int index_size = 0; // Bytes per index (2 or 4)
+
+    // Levels of detail, index ranges (index_size wide) over the same vertices
+    const void*  lod_index_data = nullptr;
+    unsigned int lod_count = 0;
+    MeshLod      lods[MESH_MAX_LODS];
+
+    // Shared Utils::MeshAsset owning the data (0 when the producing node owns it)
+    uint64_t     asset_id = 0;
+
+    // Meshes the producing node outputs next (e.g. upcoming sequence frames), renderers can upload them ahead of time
+    const MeshPrefetchList* prefetch = nullptr;
+
+    inline bool indexed() const
+    {
+        return index_count > 0;
+    }
+
+    // Vertex referenced by the i-th triangle corner
+    inline uint32_t index(size_t i) const
+    {
+        if(!indexed()) return (uint32_t)i;
+        return index_size == 2 ? ((const uint16_t*)index_data)[i] : ((const uint32_t*)index_data)[i];
+    }
+
+    // Triangle corners drawn
+    inline size_t elementCount() const
+    {
+        return indexed() ? index_count : data_size / 6;
+    }
+
+    // Level 0 is the mesh itself
+    inline uint32_t lodIndex(unsigned int level, size_t i) const
+    {
+        if(level == 0) return index(i);
+        i += lods[level - 1].first;
+        return index_size == 2 ? ((const uint16_t*)lod_index_data)[i] : ((const uint32_t*)lod_index_data)[i];
+    }
+
+    inline size_t lodElementCount(unsigned int level) const
+    {
+        return level == 0 ? elementCount() : lods[level - 1].count;
+    }
+
+    inline float lodError(unsigned int level) const
+    {
+        return level == 0 ? 0.0f : lods[level - 1].error;
+    }
+};
+
+// Only shared assets (asset_id != 0) are worth uploading ahead
+struct MeshPrefetchList
+{
+    static constexpr unsigned int MAX_MESHES = 16;
+
+    MeshNodeData meshes[MAX_MESHES];
+    unsigned int count = 0;
 };
 
 // mesh_interp_node.h output
@@ -26,6 +102,81 @@ struct ShaderNodeData
     std::string generated_code;
 };
 
+// Compact per instance attributes (as uploaded to the GPU)
+// Positions quantized to 16 bits inside the instance bounds (w is padding)
+struct InstancePosition16
+{
+    uint16_t x, y, z, w;
+};
+
+// Colors as normalized RGBA8
+struct InstanceColor8
+{
+    uint8_t r, g, b, a;
+};
+
+// Instance range [begin, end) modified since the last upload
+struct InstanceDirtyRange
+{
+    unsigned int begin = 0;
+    unsigned int end = 0;
+
+    inline void add(unsigned int b, unsigned int e)
+    {
+        if(b >= e) return;
+        if(empty())
+        {
+            begin = b;
+            end = e;
+        }
+        else
+        {
+            begin = std::min(begin, b);
+            end = std::max(end, e);
+        }
+    }
+
+    inline bool empty() const
+    {
+        return begin >= end;
+    }
+
+    inline void clear()
+    {
+        begin = end = 0;
+    }
+};
+
+// Written by the render node, consumed (and cleared) by the renderer uploads
+struct InstanceDirtyRanges
+{
+    InstanceDirtyRange position;
+    InstanceDirtyRange rotation;
+    InstanceDirtyRange color;
+    InstanceDirtyRange mesh;
+
+    inline void all(unsigned int count)
+    {
+        position.add(0, count);
+        rotation.add(0, count);
+        color.add(0, count);
+        mesh.add(0, count);
+    }
+};
+
+// One frame worth of persistently mapped instance memory (a slot of the renderer streaming ring)
+// The renderer hands a slot to the render node after each draw, the node writes every instance into it and gives it back
+// Slot memory is write only (mapped coherent), never read from it
+struct InstanceStreamSlot
+{
+    Vector3*        positions = nullptr;
+    Vector3*        rotations = nullptr;
+    InstanceColor8* colors = nullptr;
+    unsigned int    capacity = 0;  // In instances
+    unsigned int    requested = 0; // Instance count the node needs, the renderer grows the ring to fit it
+    bool            written = false;
+};
+
 // render_node.h output
 struct RenderNodeData
 {
@@ -39,10 +190,41 @@ struct RenderNodeData
     MeshNodeData** _meshPtr = nullptr;
     unsigned int   _meshCount = 0;
     float          _meshParam = 0.0f;
-    Vector4**      _worldPositionPtr = nullptr;
-    glm::mat4**    _worldRotationPtr = nullptr;
-    Vector4**      _instanceColorsPtr = nullptr;
-    glm::mat4**    _motifPositionPtr = nullptr;
+
+    // Mesh palette: _meshPtr holds _meshCount meshes and every instance draws the one at its index
+    bool           _meshPalette = false;
+    unsigned int** _meshIndexPtr = nullptr;
+    Vector3**         _worldPositionPtr = nullptr;
+    Vector3**         _worldRotationPtr = nullptr; // Euler angles, expanded in the vertex shader
+    InstanceColor8**  _instanceColorsPtr = nullptr;
+
+    // Quantized positions (only allocated with _compactPositions)
+    // The shader reconstructs them as _positionOrigin + (p / 65535) * _positionExtent
+    InstancePosition16** _worldPositionCompactPtr = nullptr;
+    bool                 _compactPositions = false;
+    Vector3              _positionOrigin = Vector3(0.0f, 0.0f, 0.0f);
+    Vector3              _positionExtent = Vector3(1.0f, 1.0f, 1.0f);
+
+    InstanceDirtyRanges* _instanceDirty = nullptr;
+
+    // Instance positions bounds, used to cull motif tiles (unknown for streamed instances)
+    bool    _instanceBoundsValid = false;
+    Vector3 _instanceBoundsMin = Vector3(0.0f, 0.0f, 0.0f);
+    Vector3 _instanceBoundsMax = Vector3(0.0f, 0.0f, 0.0f);
+
+    // Streaming mode: instances are written every frame straight into mapped GPU memory
+    bool                _streamInstances = false;
+    InstanceStreamSlot* _streamSlot = nullptr;
+
+    // Frustum culling: only the visible instances are uploaded (compacted) and drawn
+    bool _cullInstances = false;
+
+    // Mesh vertices uploaded as 16 bit positions inside the mesh bounds and octahedral normals
+    bool _compactVertices = false;
+
+    // Mesh levels of detail: instances use the coarsest level whose error projects below _lodPixelError pixels
+    bool  _meshLod = false;
+    float _lodPixelError = 1.0f;
 
     // Fog rendering data
     float   _fogMax = 50.0f;
@@ -1,7 +1,11 @@
 #pragma once
 #include "node.h"
 #include "../../math/vector.h"
+#include "../../math/list_ops.inl"
+#include "../../util/parallel.inl"
 #include "../../../muparser/include/muParser.h"
+#include <memory>
+#include <atomic>
 
 struct FunctionNode final : public PropertyNode
 {
@@ -10,10 +14,14 @@ struct FunctionNode final : public PropertyNode
         static int inc = 0;
         name = "Function Node #" + std::to_string(inc++);
 
-        setOutputNominalTypes<float, Vector2, Vector3, Vector4>("value", 
-            "The ouput of the function."
+        setOutputNominalTypes<float, Vector2, Vector3, Vector4, 
+            std::vector<float>, std::vector<Vector2>, std::vector<Vector3>, std::vector<Vector4>
+        >("value", 
+            "The ouput of the function. A list with the same size of the input list when in map mode."
         );
 
+        inputs_description["list"] = "The list to map. Each element is bound to x, y, z, w and its index to i.";
+
         _vars_name = std::vector<std::string>(1, "x");
         for(auto s : _vars_name)
         {
@@ -85,7 +93,7 @@ struct FunctionNode final : public PropertyNode
             }
 
             // TODO: Create a new input set were the currently connected ones are mutated to allow for on the fly name change
-            setInputsOrdered(strings);
+            setInputsOrdered(getInputNames(strings));
 
             // Ignore fix variable "count"
             _vars_name = std::vector<std::string>(strings.begin(), strings.end());
@@ -105,6 +113,18 @@ struct FunctionNode final : public PropertyNode
                 pw.DefineVar(s, v);
             }
             _vars_last = _vars;
+            _map_workers_dirty = true;
+        }
+
+        if(map_mode_changed)
+        {
+            if(!map_mode)
+            {
+                disconnectInputIfNotOfType<PropertyNode::EmptyType>("list");
+            }
+            setInputsOrdered(getInputNames(_vars_name));
+            _map_last_list = nullptr;
+            _map_workers_dirty = true;
         }
 
         for(auto s : _vars_name)
@@ -182,7 +202,16 @@ struct FunctionNode final : public PropertyNode
             }
         }
 
-        if(funcChanged || variables_changed || out_type_changed)
+        if(funcChanged || out_type_changed)
+        {
+            _map_workers_dirty = true;
+        }
+
+        if(map_mode)
+        {
+            updateMap(funcChanged || variables_changed || out_type_changed || map_mode_changed);
+        }
+        else if(funcChanged || variables_changed || out_type_changed || map_mode_changed)
         {
             try
             {
@@ -212,6 +241,7 @@ struct FunctionNode final : public PropertyNode
         };
 
         ImGui::Combo("Out Type", &currentmodeid, out_mode_names, sizeof(out_mode_names) / sizeof(out_mode_names[0]));
+        map_mode_changed = ImGui::Checkbox("Map over list", &map_mode);
         
         if(currentmodeid != lastmodeid)
         {
@@ -230,6 +260,12 @@ struct FunctionNode final : public PropertyNode
         if(currentmodeid > 0) _expr_changed1 = ImGui::InputText("fy", _expr_str_1, 512);
         if(currentmodeid > 1) _expr_changed2 = ImGui::InputText("fz", _expr_str_2, 512);
         if(currentmodeid > 2) _expr_changed3 = ImGui::InputText("fw", _expr_str_3, 512);
+
+        if(map_mode)
+        {
+            ImGui::Text("Element: x, y, z, w | Index: i");
+            ImGui::Text("Result: List [%llu]", (unsigned long long)map_size);
+        }
     }
 
     inline virtual ByteBuffer serialize() const override
@@ -245,6 +281,8 @@ struct FunctionNode final : public PropertyNode
         buffer.add(std::string(_expr_str_2));
         buffer.add(std::string(_expr_str_3));
 
+        buffer.add(map_mode);
+
         return buffer;
     }
 
@@ -267,7 +305,6 @@ struct FunctionNode final : public PropertyNode
         {
             strings.push_back(s);
         }
-        setInputsOrdered(strings);
 
         std::string expressions[4];
 
@@ -276,6 +313,13 @@ struct FunctionNode final : public PropertyNode
         buffer.get(&expressions[2]);
         buffer.get(&expressions[3]);
 
+        if(buffer.getVersion() >= SCENE_VERSION_NODE_OPTIONS)
+        {
+            buffer.get(&map_mode);
+        }
+        map_mode_changed = false;
+        setInputsOrdered(getInputNames(strings));
+
         strcpy(_expr_str_0, expressions[0].c_str());
         strcpy(_expr_str_1, expressions[1].c_str());
         strcpy(_expr_str_2, expressions[2].c_str());
@@ -307,12 +351,226 @@ struct FunctionNode final : public PropertyNode
             pw.DefineVar(s, v);
         }
         _vars_last = _vars;
+        _map_workers_dirty = true;
     }
 
 private:
+    // Each worker evaluates its chunk of the list in blocks of this many elements
+    inline static constexpr int MAP_BULK_SIZE = 1024;
+    inline static constexpr size_t MAP_MIN_ELEMENTS_PER_THREAD = 4 * MAP_BULK_SIZE;
+
+    // Per thread parser set for map mode
+    // Every variable is an array of MAP_BULK_SIZE values so the parsers can run in bulk
+    struct MapWorker
+    {
+        mu::Parser p[4];
+        std::vector<double> in[5]; // x, y, z, w, i
+        std::vector<double> out[4];
+        std::vector<double> extra; // User variables (MAP_BULK_SIZE each)
+
+        MapWorker()
+        {
+            for(auto& v : in)  v.resize(MAP_BULK_SIZE, 0.0);
+            for(auto& v : out) v.resize(MAP_BULK_SIZE, 0.0);
+        }
+    };
+
+    inline static bool isMapElementVar(const std::string& name)
+    {
+        return name == "x" || name == "y" || name == "z" || name == "w" || name == "i";
+    }
+
+    inline std::vector<std::string> getInputNames(const std::vector<std::string>& vars) const
+    {
+        std::vector<std::string> names = vars;
+        if(map_mode)
+        {
+            names.push_back("list");
+        }
+        return names;
+    }
+
+    inline bool configureMapWorker(MapWorker& w)
+    {
+        static const char* const element_vars[] = { "x", "y", "z", "w", "i" };
+        const char* const exprs[] = { _expr_str_0, _expr_str_1, _expr_str_2, _expr_str_3 };
+
+        w.extra.assign(_vars_name.size() * MAP_BULK_SIZE, 0.0);
+        try
+        {
+            for(int k = 0; k <= currentmodeid; k++)
+            {
+                w.p[k].ClearVar();
+                for(int v = 0; v < 5; v++)
+                {
+                    w.p[k].DefineVar(element_vars[v], w.in[v].data());
+                }
+                for(size_t j = 0; j < _vars_name.size(); j++)
+                {
+                    // The element values take precedence over user variables with the same name
+                    if(!isMapElementVar(_vars_name[j]))
+                    {
+                        w.p[k].DefineVar(_vars_name[j], w.extra.data() + j * MAP_BULK_SIZE);
+                    }
+                }
+                w.p[k].SetExpr(std::string(exprs[k]));
+                w.p[k].Eval(); // Parse now so the worker threads do not throw
+            }
+        }
+        catch(mu::Parser::exception_type &e)
+        {
+            L_ERROR("Function map setup failed: %s", e.GetMsg().c_str());
+            return false;
+        }
+        return true;
+    }
+
+    inline void updateMap(bool force)
+    {
+        disconnectInputIfNotOfType<
+            std::vector<float>, std::vector<int>, std::vector<unsigned int>, std::vector<Vector2>, std::vector<Vector3>, std::vector<Vector4>
+        >("list");
+
+        auto list_it = inputs_named.find("list");
+        PropertyGenericData* list = (list_it != inputs_named.end()) ? list_it->second : nullptr;
+
+        bool list_changed = (list != _map_last_list) || (list && list->dataChanged());
+        _map_last_list = list;
+
+        if(!force && !list_changed) return;
+
+        if(list == nullptr)
+        {
+            writeMapOutput(0);
+            map_size = 0;
+            return;
+        }
+
+             if(mapListIfOfType<float>       (list));
+        else if(mapListIfOfType<int>         (list));
+        else if(mapListIfOfType<unsigned int>(list));
+        else if(mapListIfOfType<Vector2>     (list));
+        else if(mapListIfOfType<Vector3>     (list));
+        else if(mapListIfOfType<Vector4>     (list)) {  }
+    }
+
+    // Resizes the output list to the current out type and returns its raw float data
+    inline float* writeMapOutput(size_t count)
+    {
+        switch (currentmodeid)
+        {
+            case 0: return outputs[0]->resizeList<float>(count).data();
+            case 1: return outputs[0]->resizeList<Vector2>(count).data()->data;
+            case 2: return outputs[0]->resizeList<Vector3>(count).data()->data;
+            case 3: return outputs[0]->resizeList<Vector4>(count).data()->data;
+            default: return nullptr;
+        }
+    }
+
+    template<typename E>
+    inline bool mapListIfOfType(PropertyGenericData* list)
+    {
+        using S = typename Math::ListElementTraits<E>::Scalar;
+        constexpr size_t N = Math::ListElementTraits<E>::Components;
+
+        if(!list->isOfType<std::vector<E>>()) return false;
+
+        const std::vector<E>& src_list = list->getValue<std::vector<E>>();
+        const size_t count = src_list.size();
+        const S* src = (const S*)src_list.data();
+        const size_t out_n = (size_t)currentmodeid + 1;
+
+        const size_t chunks = Utils::GetParallelChunkCount(count, MAP_MIN_ELEMENTS_PER_THREAD);
+        if(_map_workers.size() < chunks)
+        {
+            while(_map_workers.size() < chunks)
+            {
+                _map_workers.push_back(std::make_unique<MapWorker>());
+            }
+            _map_workers_dirty = true;
+        }
+
+        if(_map_workers_dirty)
+        {
+            for(auto& w : _map_workers)
+            {
+                // Downstream nodes must not keep the last list (possibly of the previous mode's type)
+                if(!configureMapWorker(*w))
+                {
+                    writeMapOutput(0);
+                    map_size = 0;
+                    return true;
+                }
+            }
+            _map_workers_dirty = false;
+        }
+
+        float* dst = writeMapOutput(count);
+        map_size = count;
+        if(count == 0) return true;
+
+        std::atomic<bool> failed = false;
+        Utils::ParallelForChunks(count, chunks, [&](size_t chunk, size_t begin, size_t end) {
+            MapWorker& w = *_map_workers[chunk];
+
+            for(size_t j = 0; j < _vars.size(); j++)
+            {
+                std::fill_n(w.extra.data() + j * MAP_BULK_SIZE, MAP_BULK_SIZE, _vars[j]);
+            }
+
+            try
+            {
+                for(size_t b = begin; b < end; b += MAP_BULK_SIZE)
+                {
+                    const int n = (int)std::min<size_t>(MAP_BULK_SIZE, end - b);
+                    for(int e = 0; e < n; e++)
+                    {
+                        const S* elem = src + (b + e) * N;
+                        for(size_t c = 0; c < 4; c++)
+                        {
+                            w.in[c][e] = (c < N) ? (double)elem[c] : 0.0;
+                        }
+                        w.in[4][e] = (double)(b + e);
+                    }
+
+                    for(size_t k = 0; k < out_n; k++)
+                    {
+                        w.p[k].Eval(w.out[k].data(), n);
+                    }
+
+                    float* out = dst + b * out_n;
+                    for(int e = 0; e < n; e++)
+                    {
+                        for(size_t k = 0; k < out_n; k++)
+                        {
+                            out[e * out_n + k] = (float)w.out[k][e];
+                        }
+                    }
+                }
+            }
+            catch(mu::Parser::exception_type &)
+            {
+                failed = true;
+            }
+        });
+
+        if(failed)
+        {
+            L_ERROR("Function map evaluation failed.");
+        }
+        return true;
+    }
+
     int currentmodeid = 0;
     int lastmodeid = 0;
 
+    bool map_mode = false;
+    bool map_mode_changed = false;
+    bool _map_workers_dirty = true;
+    size_t map_size = 0;
+    PropertyGenericData* _map_last_list = nullptr;
+    std::vector<std::unique_ptr<MapWorker>> _map_workers;
+
     bool vars_changed;
     bool _expr_changed0;
     bool _expr_changed1;
@@ -1,6 +1,7 @@
 #pragma once
 #include "node.h"
 #include "../../math/vector.h"
+#include "../../util/parallel.inl"
 #include "../../../glm/glm/glm.hpp"
 #include "../../../muparser/include/muParser.h"
 
@@ -11,13 +12,11 @@ struct ListAccessNode final : public PropertyNode
         static int inc = 0;
         name = "List Access Node #" + std::to_string(inc++);
 
-        inputs_description["index"] = "The list index to lookup.";
+        inputs_description["index"] = "The list index to lookup. A list of indices in batched mode.";
         inputs_description["list"] = "The list object to lookup.";
+        inputs_description["value"] = "The value to write at the index. A list of values (or a single value) to scatter in batched mode.";
 
-        setOutputNominalTypes<float>("value", 
-            "The list index corresponding value."
-        );
-
+        updateOutputNominalTypes();
     }
     
     ~ListAccessNode()
@@ -39,7 +38,11 @@ struct ListAccessNode final : public PropertyNode
     {
         auto data = outputs[0];
         auto idx_it = inputs_named.find("index");
-        if(idx_it != inputs_named.end())
+        if(batched)
+        {
+            ImGui::Text("Indices: List [%llu]", (unsigned long long)batch_indices.size());
+        }
+        else if(idx_it != inputs_named.end())
         {
             ImGui::BeginDisabled();
             ImGui::InputInt("Index", &idx);
@@ -50,6 +53,13 @@ struct ListAccessNode final : public PropertyNode
             ImGui::InputInt("Index", &idx);
         }
 
+        if(ImGui::Checkbox("Batched", &batched))
+        {
+            last_list = nullptr;
+            last_indices = nullptr;
+            updateOutputNominalTypes();
+        }
+
         if(ImGui::Checkbox("Modifiable", &mod))
         {
             if(mod)
@@ -74,7 +84,11 @@ struct ListAccessNode final : public PropertyNode
             }
         }
 
-        if(list_connected)
+        if(list_connected && batched)
+        {
+            ImGui::Text("Value: List [%llu]", (unsigned long long)data->getListSize());
+        }
+        else if(list_connected)
         {
             ImGui::BeginDisabled(!mod && !val_connected);
             switch(dtype)
@@ -107,6 +121,12 @@ struct ListAccessNode final : public PropertyNode
         auto data = outputs[0];
         data->resetDataUpdate();
 
+        if(batched)
+        {
+            updateBatched();
+            return;
+        }
+
         disconnectInputIfNotOfType<unsigned int, int>("index");
 
         disconnectInputIfNotOfType<
@@ -283,6 +303,7 @@ struct ListAccessNode final : public PropertyNode
 
         buffer.add(idx);
         buffer.add(mod);
+        buffer.add(batched);
 
         return buffer;
     }
@@ -293,6 +314,11 @@ struct ListAccessNode final : public PropertyNode
         
         buffer.get(&idx);
         buffer.get(&mod);
+        if(buffer.getVersion() >= SCENE_VERSION_NODE_OPTIONS)
+        {
+            buffer.get(&batched);
+        }
+        updateOutputNominalTypes();
 
         if(mod)
         {
@@ -317,10 +343,191 @@ struct ListAccessNode final : public PropertyNode
     }
 
 private:
+    // Batched mode outputs a list of the looked up values
+    inline void updateOutputNominalTypes()
+    {
+        if(batched)
+        {
+            setOutputNominalTypes<
+                std::vector<float>, std::vector<int>, std::vector<unsigned int>, std::vector<Vector2>, std::vector<Vector3>, std::vector<Vector4>
+            >("value", "A list with the values at every index of the index list.");
+        }
+        else
+        {
+            setOutputNominalTypes<float, int, unsigned int, Vector2, Vector3, Vector4>("value", "The list index corresponding value.");
+        }
+    }
+
     int idx = 0;
     bool mod = false;
+    bool batched = false;
     bool val_connected = false;
     bool list_connected = false;
 
     DisplayType dtype;
+
+    // Batched mode state
+    static constexpr size_t GATHER_MIN_ELEMENTS_PER_THREAD = 1 << 16;
+    std::vector<unsigned int> batch_indices;
+    PropertyGenericData* last_list = nullptr;
+    PropertyGenericData* last_indices = nullptr;
+
+    // A list segment, the element at list index i is src[(i - first) * stride]
+    template<typename T>
+    struct GatherRun
+    {
+        size_t first;
+        const T* src;
+        size_t stride;
+    };
+
+    inline void updateBatched()
+    {
+        disconnectInputIfNotOfType<std::vector<unsigned int>, std::vector<int>>("index");
+
+        disconnectInputIfNotOfType<
+            std::vector<float>, 
+            std::vector<int>, 
+            std::vector<unsigned int>,
+            std::vector<Vector2>,
+            std::vector<Vector3>,
+            std::vector<Vector4>
+        >("list");
+
+        auto list_it = inputs_named.find("list");
+        auto idx_it = inputs_named.find("index");
+        auto value_it = inputs_named.find("value");
+        list_connected = (list_it != inputs_named.end());
+        val_connected = (value_it != inputs_named.end());
+        PropertyGenericData* value = val_connected ? value_it->second : nullptr;
+
+        PropertyGenericData* indices = (idx_it != inputs_named.end()) ? idx_it->second : nullptr;
+        bool indices_changed = (indices != last_indices) || (indices && indices->dataChanged());
+        last_indices = indices;
+
+        if(indices_changed)
+        {
+            // Index views are read without being materialized
+            batch_indices.clear();
+            if(indices && indices->isOfType<std::vector<unsigned int>>())
+            {
+                batch_indices.resize(indices->getListSize());
+                batch_indices.resize(indices->copyListTo(batch_indices.data()));
+            }
+            else if(indices && indices->isOfType<std::vector<int>>())
+            {
+                batch_indices.resize(indices->getListSize());
+                indices->forEachListSegment<int>([&](size_t first, const int* src, size_t count, size_t stride) {
+                    for(size_t i = 0; i < count; i++)
+                    {
+                        batch_indices[first + i] = (unsigned int)std::max(src[i * stride], 0);
+                    }
+                });
+            }
+        }
+
+        if(!list_connected)
+        {
+            last_list = nullptr;
+            return;
+        }
+
+        PropertyGenericData* list = list_it->second;
+        bool list_changed = (list != last_list) || list->dataChanged() || indices_changed;
+        last_list = list;
+
+             if(batchIfOfType<float>       (list, value, DisplayType::FLOAT,        list_changed));
+        else if(batchIfOfType<int>         (list, value, DisplayType::INT,          list_changed));
+        else if(batchIfOfType<unsigned int>(list, value, DisplayType::UNSIGNED_INT, list_changed));
+        else if(batchIfOfType<Vector2>     (list, value, DisplayType::VECTOR2,      list_changed));
+        else if(batchIfOfType<Vector3>     (list, value, DisplayType::VECTOR3,      list_changed));
+        else if(batchIfOfType<Vector4>     (list, value, DisplayType::VECTOR4,      list_changed)) {  }
+    }
+
+    template<typename T>
+    inline bool batchIfOfType(PropertyGenericData* listData, PropertyGenericData* valueData, DisplayType type, bool changed)
+    {
+        if(!listData->isOfType<std::vector<T>>()) return false;
+        dtype = type;
+
+        // Scatter: write only the elements that differ, directly into the list
+        // A view input gets materialized once on the first write, leaving its sources untouched
+        if(mod && val_connected && !disconnectInputIfNotOfType<T, std::vector<T>>("value"))
+        {
+            auto& list = listData->getValue<std::vector<T>>();
+            const size_t size = list.size();
+            bool written = false;
+            if(valueData->isOfType<T>())
+            {
+                const T& v = valueData->getValue<T>();
+                for(unsigned int i : batch_indices)
+                {
+                    if(i < size && !(list[i] == v))
+                    {
+                        list[i] = v;
+                        written = true;
+                    }
+                }
+            }
+            else
+            {
+                auto& values = valueData->getValue<std::vector<T>>();
+                const size_t n = std::min(values.size(), batch_indices.size());
+                for(size_t k = 0; k < n; k++)
+                {
+                    unsigned int i = batch_indices[k];
+                    if(i < size && !(list[i] == values[k]))
+                    {
+                        list[i] = values[k];
+                        written = true;
+                    }
+                }
+            }
+
+            if(written)
+            {
+                listData->setDataChanged();
+                changed = true;
+            }
+        }
+
+        if(!changed) return true;
+
+        // Gather: one pass over the indices, out of range indices clamp to the last element
+        // Views are read from their segments, the list is never copied
+        std::vector<GatherRun<T>> runs;
+        size_t size = 0;
+        listData->forEachListSegment<T>([&](size_t first, const T* src, size_t count, size_t stride) {
+            runs.push_back({ first, src, stride });
+            size = first + count;
+        });
+
+        auto& out = outputs[0]->resizeList<T>(size > 0 ? batch_indices.size() : 0);
+        if(size > 0)
+        {
+            const GatherRun<T>* run_data = runs.data();
+            const size_t run_count = runs.size();
+            const unsigned int* idx_data = batch_indices.data();
+            const unsigned int last = (unsigned int)(size - 1);
+            T* dst = out.data();
+            Utils::ParallelFor(out.size(), GATHER_MIN_ELEMENTS_PER_THREAD, [=](size_t begin, size_t end) {
+                if(run_count == 1 && run_data->stride == 1)
+                {
+                    for(size_t k = begin; k < end; k++)
+                    {
+                        dst[k] = run_data->src[std::min(idx_data[k], last)];
+                    }
+                    return;
+                }
+
+                for(size_t k = begin; k < end; k++)
+                {
+                    const size_t i = std::min(idx_data[k], last);
+                    const GatherRun<T>* run = std::upper_bound(run_data, run_data + run_count, i, [](size_t v, const GatherRun<T>& r) { return v < r.first; }) - 1;
+                    dst[k] = run->src[(i - run->first) * run->stride];
+                }
+            });
+        }
+        return true;
+    }
 };
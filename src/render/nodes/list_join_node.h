@@ -34,6 +34,13 @@ struct ListJoinNode final : public PropertyNode
 
     
     inline virtual void render() override
+    {
+        ImGui::BeginDisabled();
+        ImGui::InputScalar("Size", ImGuiDataType_U32, &list_size);
+        ImGui::EndDisabled();
+    }
+
+    inline virtual void update() override
     {
         resetOutputsDataUpdate();
         
@@ -57,68 +64,63 @@ struct ListJoinNode final : public PropertyNode
 
         auto listAit = inputs_named.find("list A");
         auto listBit = inputs_named.find("list B");
+        PropertyGenericData* listA = (listAit != inputs_named.end()) ? listAit->second : nullptr;
+        PropertyGenericData* listB = (listBit != inputs_named.end()) ? listBit->second : nullptr;
 
-        if(listAit != inputs_named.end())
-        {
-            auto listAData = listAit->second;
-
-                 if(joinSimilarListTypesIfOfType<std::vector<float>>       (listAData, listBit));
-            else if(joinSimilarListTypesIfOfType<std::vector<int>>         (listAData, listBit));
-            else if(joinSimilarListTypesIfOfType<std::vector<unsigned int>>(listAData, listBit));
-            else if(joinSimilarListTypesIfOfType<std::vector<Vector2>>     (listAData, listBit));
-            else if(joinSimilarListTypesIfOfType<std::vector<Vector3>>     (listAData, listBit));
-            else if(joinSimilarListTypesIfOfType<std::vector<Vector4>>     (listAData, listBit)) {  }
-        }
-        else if(listBit != inputs_named.end())
+        bool changed = (listA != last_list_a) || (listB != last_list_b);
+        changed |= (listA && listA->dataChanged()) || (listB && listB->dataChanged());
+        last_list_a = listA;
+        last_list_b = listB;
+
+        if(!changed) return;
+
+        // Only the segments are updated here, the elements are never copied unless a consumer needs them contiguous
+        PropertyGenericData* fixed = listA ? listA : listB;
+        if(fixed == nullptr)
         {
-            auto listBData = listBit->second;
-            if(listBData->dataChanged() || inputs.size() != linput_size)
-            {
-                if(listBData->isOfType<std::vector<float>>())        
-                { setNamedOutput("list", listBData->getValue<std::vector<float>>());        setNamedOutput("size", (unsigned int)listBData->getValue<std::vector<float>>().size());        }
-                else if(listBData->isOfType<std::vector<int>>())          
-                { setNamedOutput("list", listBData->getValue<std::vector<int>>());          setNamedOutput("size", (unsigned int)listBData->getValue<std::vector<int>>().size());          }
-                else if(listBData->isOfType<std::vector<unsigned int>>()) 
-                { setNamedOutput("list", listBData->getValue<std::vector<unsigned int>>()); setNamedOutput("size", (unsigned int)listBData->getValue<std::vector<unsigned int>>().size()); }
-                else if(listBData->isOfType<std::vector<Vector2>>())      
-                { setNamedOutput("list", listBData->getValue<std::vector<Vector2>>());      setNamedOutput("size", (unsigned int)listBData->getValue<std::vector<Vector2>>().size());      }
-                else if(listBData->isOfType<std::vector<Vector3>>())      
-                { setNamedOutput("list", listBData->getValue<std::vector<Vector3>>());      setNamedOutput("size", (unsigned int)listBData->getValue<std::vector<Vector3>>().size());      }
-                else if(listBData->isOfType<std::vector<Vector4>>())      
-                { setNamedOutput("list", listBData->getValue<std::vector<Vector4>>());      setNamedOutput("size", (unsigned int)listBData->getValue<std::vector<Vector4>>().size());      }
-            }
+            setNamedOutput("list", EmptyType());
         }
-        else if(inputs.size() == 0 && inputs.size() != linput_size)
+        else if(joinSimilarListTypesIfOfType<float>       (fixed, listA ? listB : nullptr));
+        else if(joinSimilarListTypesIfOfType<int>         (fixed, listA ? listB : nullptr));
+        else if(joinSimilarListTypesIfOfType<unsigned int>(fixed, listA ? listB : nullptr));
+        else if(joinSimilarListTypesIfOfType<Vector2>     (fixed, listA ? listB : nullptr));
+        else if(joinSimilarListTypesIfOfType<Vector3>     (fixed, listA ? listB : nullptr));
+        else if(joinSimilarListTypesIfOfType<Vector4>     (fixed, listA ? listB : nullptr)) {  }
+
+        list_size = (unsigned int)outputs_named["list"]->getListSize();
+        setNamedOutput("size", list_size);
+    }
+
+    inline virtual void onDisconnect(const std::string& inputName) override
+    {
+        // The joined view must not reference a deleted list
+        // Rebuild it on the next update
+        if(inputName == "list A" || inputName == "list B")
         {
             setNamedOutput("list", EmptyType());
-            setNamedOutput("size", 0U);
+            last_list_a = nullptr;
+            last_list_b = nullptr;
+            list_size = 0;
         }
-
-        linput_size = (unsigned int)inputs.size();
     }
 
 private:
-    template<typename ListType>
-    inline bool joinSimilarListTypesIfOfType(PropertyGenericData* fixed, std::map<std::string, PropertyGenericData*>::iterator it)
+    template<typename T>
+    inline bool joinSimilarListTypesIfOfType(PropertyGenericData* fixed, PropertyGenericData* other)
     {
-        if(fixed->isOfType<ListType>())
+        if(fixed->isOfType<std::vector<T>>())
         {
-            if(it != inputs_named.end())
+            std::vector<PropertyGenericData::ListSegment> segments(1);
+            segments[0].source = fixed;
+            segments[0].count = SIZE_MAX;
+
+            if(other != nullptr)
             {
-                auto other = it->second;
-                if(other->isOfType<ListType>())
+                if(other->isOfType<std::vector<T>>())
                 {
-                    if(fixed->dataChanged() || other->dataChanged() || inputs.size() != linput_size)
-                    {
-                        ListType destination;
-                        ListType valA = fixed->getValue<ListType>();
-                        ListType valB = other->getValue<ListType>();
-                        destination.reserve(valA.size() + valB.size());
-                        destination.insert(destination.end(), valA.begin(), valA.end());
-                        destination.insert(destination.end(), valB.begin(), valB.end());
-                        setNamedOutput("list", destination);
-                        setNamedOutput("size", (unsigned int)destination.size());
-                    }
+                    segments.resize(2);
+                    segments[1].source = other;
+                    segments[1].count = SIZE_MAX;
                 }
                 else
                 {
@@ -127,16 +129,14 @@ private:
                     L_WARNING("Type : %s", other->type.name());
                 }
             }
-            else if(fixed->dataChanged() || inputs.size() != linput_size)
-            {
-                ListType valA = fixed->getValue<ListType>();
-                setNamedOutput("list", valA);
-                setNamedOutput("size", (unsigned int)valA.size());
-            }
+
+            outputs_named["list"]->setListView<T>(segments);
             return true;
         }
         return false;
     }
 
-    unsigned int linput_size = 0;
+    unsigned int list_size = 0;
+    PropertyGenericData* last_list_a = nullptr;
+    PropertyGenericData* last_list_b = nullptr;
 };
@@ -1,6 +1,8 @@
 #pragma once
 #include "node.h"
 #include "../../math/vector.h"
+#include "../../math/list_ops.inl"
+#include "../../util/parallel.inl"
 
 struct MathNode final : public PropertyNode
 {
@@ -43,7 +45,11 @@ struct MathNode final : public PropertyNode
         if(!inputs.empty())
         {   
             ImGui::BeginDisabled();
-            if(data->isOfType<int>())
+            if(list_output)
+            {
+                ImGui::Text("Result: List [%llu]", (unsigned long long)list_size);
+            }
+            else if(data->isOfType<int>())
             {
                 ImGui::InputInt("Result", &data->getValue<int>());
             }
@@ -75,8 +81,26 @@ struct MathNode final : public PropertyNode
     {
         outputs[0]->resetDataUpdate();
 
-        disconnectInputIfNotOfType<int, unsigned int, float, Vector2, Vector3, Vector4>("A");
-        disconnectInputIfNotOfType<int, unsigned int, float, Vector2, Vector3, Vector4>("B");
+        disconnectInputIfNotOfType<int, unsigned int, float, Vector2, Vector3, Vector4,
+            std::vector<float>, std::vector<int>, std::vector<unsigned int>, std::vector<Vector2>, std::vector<Vector3>, std::vector<Vector4>
+        >("A");
+        disconnectInputIfNotOfType<int, unsigned int, float, Vector2, Vector3, Vector4,
+            std::vector<float>, std::vector<int>, std::vector<unsigned int>, std::vector<Vector2>, std::vector<Vector3>, std::vector<Vector4>
+        >("B");
+
+        auto a_it = inputs_named.find("A");
+        auto b_it = inputs_named.find("B");
+        PropertyGenericData* a_data = (a_it != inputs_named.end()) ? a_it->second : nullptr;
+        PropertyGenericData* b_data = (b_it != inputs_named.end()) ? b_it->second : nullptr;
+
+        list_output = isListInput(a_data) || isListInput(b_data);
+        if(list_output)
+        {
+            updateList(a_data, b_data);
+            return;
+        }
+        last_a = nullptr;
+        last_b = nullptr;
 
         if(!inputs.empty())
         {
@@ -127,6 +151,132 @@ struct MathNode final : public PropertyNode
 private:
     int currentmodeid = 0;
 
+    // List outputs are only recomputed when something changes
+    bool list_output = false;
+    size_t list_size = 0;
+    PropertyGenericData* last_a = nullptr;
+    PropertyGenericData* last_b = nullptr;
+    Mode last_mode = Mode::ADD;
+
+    // Below this many scalars per thread the kernels run single threaded
+    inline static constexpr size_t LIST_OP_MIN_SCALARS_PER_THREAD = 1 << 16;
+
+    inline static bool isListInput(PropertyGenericData* d)
+    {
+        return d && d->isOfType<
+            std::vector<float>, std::vector<int>, std::vector<unsigned int>, std::vector<Vector2>, std::vector<Vector3>, std::vector<Vector4>
+        >();
+    }
+
+    inline Math::BinaryOp getBinaryOp() const
+    {
+        switch (mode)
+        {
+            case Mode::ADD: return Math::BinaryOp::ADD;
+            case Mode::SUB: return Math::BinaryOp::SUB;
+            case Mode::MUL: return Math::BinaryOp::MUL;
+            case Mode::DIV: return Math::BinaryOp::DIV;
+        }
+        return Math::BinaryOp::ADD;
+    }
+
+    inline void updateList(PropertyGenericData* a, PropertyGenericData* b)
+    {
+        bool changed = (a != last_a) || (b != last_b) || (mode != last_mode);
+        changed |= (a && a->dataChanged()) || (b && b->dataChanged());
+        if(!changed) return;
+
+        last_a = a;
+        last_b = b;
+        last_mode = mode;
+
+        // The list operand drives the output type
+        // If only B is a list, A is broadcast on the left side of the operation
+        PropertyGenericData* list  = isListInput(a) ? a : b;
+        PropertyGenericData* other = (list == a) ? b : a;
+        bool reversed = (list == b) && (other != nullptr);
+
+             if(listOpIfOfType<float>       (list, other, reversed));
+        else if(listOpIfOfType<int>         (list, other, reversed));
+        else if(listOpIfOfType<unsigned int>(list, other, reversed));
+        else if(listOpIfOfType<Vector2>     (list, other, reversed));
+        else if(listOpIfOfType<Vector3>     (list, other, reversed));
+        else if(listOpIfOfType<Vector4>     (list, other, reversed)) {  }
+    }
+
+    template<typename E>
+    inline bool listOpIfOfType(PropertyGenericData* list, PropertyGenericData* other, bool reversed)
+    {
+        using S = typename Math::ListElementTraits<E>::Scalar;
+        constexpr size_t N = Math::ListElementTraits<E>::Components;
+        constexpr size_t min_chunk = LIST_OP_MIN_SCALARS_PER_THREAD / N;
+
+        if(!list->isOfType<std::vector<E>>()) return false;
+
+        const std::vector<E>& src = list->getValue<std::vector<E>>();
+        const Math::BinaryOp op = getBinaryOp();
+
+        if(other == nullptr)
+        {
+            outputs[0]->setValue(src);
+            list_size = src.size();
+            return true;
+        }
+
+        if(other->isOfType<std::vector<E>>())
+        {
+            // List x List (the shortest list sets the output size)
+            const std::vector<E>& src_other = other->getValue<std::vector<E>>();
+            const size_t count = std::min(src.size(), src_other.size());
+            if(src.size() != src_other.size())
+            {
+                L_WARNING("MathNode: List sizes differ (%llu and %llu). Using the shortest.", (unsigned long long)src.size(), (unsigned long long)src_other.size());
+            }
+
+            const S* pa = (const S*)src.data();
+            const S* pb = (const S*)src_other.data();
+            S* pd = (S*)outputs[0]->resizeList<E>(count).data();
+
+            Utils::ParallelFor(count, min_chunk, [=](size_t begin, size_t end) {
+                Math::ListBinaryOp(op, pa + begin * N, pb + begin * N, pd + begin * N, (end - begin) * N);
+            });
+            list_size = count;
+            return true;
+        }
+
+        // List x Element (VectorN for VectorN lists, any float for vector lists)
+        S pattern[4];
+        size_t period;
+        if(other->isOfType<E>())
+        {
+            memcpy(pattern, &other->getValue<E>(), sizeof(E));
+            period = N;
+        }
+        else if(N > 1 && other->isOfType<float>())
+        {
+            pattern[0] = (S)other->getValue<float>();
+            period = 1;
+        }
+        else
+        {
+            L_ERROR("MathNode: A %s can only operate with a list or value of the same type.", PropertyGenericData::ValidTypeMap<std::vector<E>>::value);
+            disconnectInputIfNotOfType<EmptyType>(reversed ? "A" : "B");
+            outputs[0]->setValue(src);
+            list_size = src.size();
+            return true;
+        }
+
+        const size_t count = src.size();
+        const S* pa = (const S*)src.data();
+        S* pd = (S*)outputs[0]->resizeList<E>(count).data();
+
+        Utils::ParallelFor(count, min_chunk, [=, &pattern](size_t begin, size_t end) {
+            Math::ListBroadcastOp(op, reversed, pa + begin * N, pattern, period, pd + begin * N, (end - begin) * N);
+        });
+        list_size = count;
+        return true;
+    }
+
     template<typename T1, typename T2, typename... Args>
     inline bool assingAllTypes(PropertyGenericData* f, PropertyGenericData* s)
     {
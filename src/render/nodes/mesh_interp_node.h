@@ -80,7 +80,7 @@ struct MeshInterpolatorNode final : public PropertyNode
 
         if(size_mismatch_error)
         {
-            ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "Error: Mesh vertex size must match.");
+            ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "Error: Mesh vertices and triangles must match.");
         }
 
         // ImGui::Text("0 <= t <= meshCount");
@@ -271,13 +271,54 @@ private:
         }
     }
 
+    static bool SameIndices(const MeshNodeData& a, const MeshNodeData& b)
+    {
+        if(a.index_count != b.index_count) return false;
+        for(size_t i = 0; i < a.index_count; i++)
+        {
+            if(a.index(i) != b.index(i)) return false;
+        }
+        return true;
+    }
+
+    // Corners are blended one to one instead, for meshes whose indices differ (e.g. flat shaded morph targets)
+    void expandMeshes()
+    {
+        std::vector<std::vector<float>> expanded;
+        expanded.reserve(mesh_list.meshes.size());
+        for(MeshNodeData& m : mesh_list.meshes)
+        {
+            expanded.push_back(Utils::ExpandIndexedMesh(m));
+            m = MeshNodeData();
+            m.vertex_data = expanded.back().data();
+            m.data_size = expanded.back().size();
+        }
+        expanded_meshes = std::move(expanded);
+    }
+
     void updatePrecooked()
     {
+        // Vertices are blended one to one, so indexed meshes must share the same triangles too
+        bool indicesMatch = true;
+        bool cornersMatch = true;
+        for(const MeshNodeData& m : mesh_list.meshes)
+        {
+            const MeshNodeData& first = mesh_list.meshes.front();
+            indicesMatch &= m.data_size == first.data_size && SameIndices(m, first);
+            cornersMatch &= m.elementCount() == first.elementCount();
+        }
+        const bool expand = !indicesMatch && cornersMatch;
+        if(expand)
+        {
+            expandMeshes();
+        }
+
         size_mismatch_error = false;
         size_t lastDataSize = 0;
+        MeshNodeData first;
         for(auto m : mesh_list.meshes)
         {
-            if(lastDataSize != 0 && m.data_size != lastDataSize)
+            if(lastDataSize != 0 && (m.data_size != lastDataSize || !SameIndices(m, first)))
             {
                 size_mismatch_error = true;
                 mesh_list.meshes.clear();
@@ -285,14 +326,17 @@ private:
                 disconnectAllInputsIfNotOfType<EmptyType>();
                 mesh_list.changeParamOnly = false;
                 outputs[0]->setValue(mesh_list);
+                break;
             }
             else
             {
+                if(lastDataSize == 0) first = m;
                 lastDataSize = m.data_size;
             }
         }
 
-        if(!size_mismatch_error && current_mesh_changed)
+        // The output still points at the meshes from before the expansion
+        if(!size_mismatch_error && (current_mesh_changed || expand))
         {
             mesh_list.totalMeshesDataSize = lastDataSize * mesh_list.meshes.size();
             mesh_list.changeParamOnly = false;
@@ -301,6 +345,7 @@ private:
     }
 
     MeshInterpListData mesh_list;
+    std::vector<std::vector<float>> expanded_meshes; // Owns the vertices of expanded meshes in mesh_list
     int sample_count = 1000;
 
     std::set<size_t> used_nodes_indices;
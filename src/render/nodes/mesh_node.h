@@ -2,8 +2,7 @@
 #include "node.h"
 #include "../node_outputs.h"
 #include "../../util/imgui_ext.inl"
-#include "../../util/objloader.h"
-#include <future>
+#include "../../util/mesh_asset.h"
 // #include <glad/glad.h>
 // #include <GLFW/glfw3.h>
 
@@ -30,14 +29,6 @@ struct MeshNode final : public PropertyNode
         // GLuint _preview_tex;
     }
     
-    ~MeshNode()
-    {
-        if(vertices_data.vertex_data != nullptr)
-        {
-            delete[] vertices_data.vertex_data;
-        }
-    }
-
     inline virtual void render() override
     {
         auto data = outputs[0];
@@ -48,6 +39,17 @@ struct MeshNode final : public PropertyNode
         {
             //TODO: Display a model preview on the node
             ImGui::Text("Currently loaded: %s", std::filesystem::path(to_load).filename().string().c_str());
+
+            if(asset->lods() == nullptr)
+            {
+                ImGuiExt::SpinnerText();
+                ImGui::SameLine();
+                ImGui::Text("Generating LODs...");
+            }
+            else
+            {
+                ImGui::Text("LODs: %u", vertices_data.lod_count);
+            }
         }
         
         bool closepopup = false;
@@ -55,21 +57,33 @@ struct MeshNode final : public PropertyNode
         if(ImGuiExt::FileBrowser(&to_load, ext) || loaded_savefile)
         {
             loaded_savefile = false;
-            // Thread the file loading
+            // Loaded in the background, or shared with another node that uses the same file
             if(!loading)
             {
-                f_fdata = std::async(Utils::LoadFloatVertexDataFromFile, to_load);
+                pending = Utils::MeshAssetManager::Acquire(to_load);
                 loading = true;
             }
         }
         
-        if(f_fdata.valid())
+        if(pending)
         {
-            if(f_fdata.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+            const Utils::CachedMeshData* mesh = pending->mesh();
+            if(mesh != nullptr)
             {
                 closepopup = true;
-                fdata = f_fdata.get();
                 loading = false;
+
+                // The previous mesh (if any) is kept on failure
+                if(!mesh->mesh.empty())
+                {
+                    L_DEBUG("mesh_node: loaded obj file.");
+                    valid_model = true;
+                    asset = std::move(pending);
+                    asset->view(&vertices_data);
+                    lods_applied = vertices_data.lod_count > 0;
+                    data->setValue(vertices_data);
+                }
+                pending.reset();
             }
             else if(loading && !popupOpened)
             {
@@ -77,23 +91,16 @@ struct MeshNode final : public PropertyNode
                 L_TRACE("Loading popup open.");
                 ImGui::OpenPopup("Please Wait");
             }
+        }
 
-            if(!fdata.empty())
+        // The LODs arrive after the mesh
+        if(asset && !lods_applied && asset->lods() != nullptr)
+        {
+            lods_applied = true;
+            asset->view(&vertices_data);
+            if(vertices_data.lod_count > 0)
             {
-                L_DEBUG("mesh_node: loaded obj file.");
-                valid_model = true;
-
-                vertices_data.data_size = fdata.size();
-                if(vertices_data.vertex_data != nullptr)
-                {
-                    delete[] vertices_data.vertex_data;
-                }
-                vertices_data.vertex_data = new float[vertices_data.data_size];
-
-                memcpy(vertices_data.vertex_data, fdata.data(), fdata.size() * sizeof(float));
-
                 data->setValue(vertices_data);
-                fdata.clear();
             }
         }
 
@@ -131,9 +138,10 @@ struct MeshNode final : public PropertyNode
 
 private:
     std::string to_load;
-    MeshNodeData vertices_data;
-    std::future<std::vector<float>> f_fdata;
-    std::vector<float> fdata;
+    MeshNodeData vertices_data; // Points into asset
+    std::shared_ptr<const Utils::MeshAsset> asset;
+    std::shared_ptr<const Utils::MeshAsset> pending;
+    bool lods_applied = false;
     bool valid_model = false;
     bool loading = false;
     bool popupOpened = false;
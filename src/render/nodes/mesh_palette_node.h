@@ -0,0 +1,75 @@
+#pragma once
+#include "node.h"
+#include "../node_outputs.h"
+
+// Collects meshes into a palette, the Render Node "meshIndex" input picks one per instance
+struct MeshPaletteNode final : public PropertyNode
+{
+    static constexpr int MAX_PALETTE_SIZE = 8;
+
+    inline MeshPaletteNode() : PropertyNode(Type::MESHPALETTE, MAX_PALETTE_SIZE, {
+        "mesh 0", "mesh 1", "mesh 2", "mesh 3", "mesh 4", "mesh 5", "mesh 6", "mesh 7"
+    }, 1, { "palette" })
+    {
+        static int inc = 0;
+        name = "Mesh Palette Node #" + std::to_string(inc++);
+
+        for(int i = 0; i < MAX_PALETTE_SIZE; i++)
+        {
+            inputs_description["mesh " + std::to_string(i)] = "The mesh drawn for instances with mesh index " + std::to_string(i) + ".";
+        }
+
+        setOutputNominalTypes<MeshInterpListData>(
+            "palette",
+            "The meshes in input order. Link it to a Render Node \"mesh\" input together with a \"meshIndex\" list."
+        );
+    }
+
+    ~MeshPaletteNode() {  }
+
+    inline virtual void render() override
+    {
+        ImGui::Text("Meshes: %u", (unsigned int)palette.meshes.size());
+    }
+
+    inline virtual void update() override
+    {
+        resetOutputsDataUpdate();
+
+        bool changed = false;
+        for(int i = 0; i < MAX_PALETTE_SIZE; i++)
+        {
+            const std::string input = "mesh " + std::to_string(i);
+            disconnectInputIfNotOfType<MeshNodeData>(input);
+
+            auto it = inputs_named.find(input);
+            PropertyGenericData* mesh = (it != inputs_named.end()) ? it->second : nullptr;
+            changed |= (mesh != last_inputs[i]) || (mesh && mesh->dataChanged());
+            last_inputs[i] = mesh;
+        }
+
+        if(!changed) return;
+
+        // Unlinked slots keep their index (they draw nothing), trailing ones are dropped
+        palette.meshes.clear();
+        palette.totalMeshesDataSize = 0;
+        for(int i = 0; i < MAX_PALETTE_SIZE; i++)
+        {
+            MeshNodeData mesh = last_inputs[i] ? last_inputs[i]->getValue<MeshNodeData>() : MeshNodeData();
+            palette.meshes.push_back(mesh);
+            palette.totalMeshesDataSize += mesh.data_size;
+        }
+        while(!palette.meshes.empty() && palette.meshes.back().data_size == 0)
+        {
+            palette.meshes.pop_back();
+        }
+
+        palette.t = 0.0f;
+        palette.changeParamOnly = false;
+        outputs[0]->setValue(palette);
+    }
+
+private:
+    MeshInterpListData palette;
+    PropertyGenericData* last_inputs[MAX_PALETTE_SIZE] = {};
+};
@@ -0,0 +1,315 @@
+#pragma once
+#include "node.h"
+#include "../node_outputs.h"
+#include "../../util/imgui_ext.inl"
+#include "../../util/mesh_asset.h"
+#include <filesystem>
+#include <climits>
+#include <cctype>
+
+// Plays back a per frame obj sequence, upcoming frames are loaded in the background into a bounded ring
+struct MeshSequenceNode final : public PropertyNode
+{
+    static constexpr int MAX_PREFETCH = 16;
+
+    inline MeshSequenceNode() : PropertyNode(Type::MESHSEQUENCE, 1, { "t" }, 1, { "mesh" })
+    {
+        static int inc = 0;
+        name = "Mesh Sequence Node #" + std::to_string(inc++);
+
+        inputs_description["t"] = "Playback time in seconds (the application time when not connected).";
+
+        setOutputNominalTypes<MeshNodeData>("mesh", "The mesh of the current frame.");
+
+        pattern[0] = '\0';
+        resizeRing();
+    }
+
+    ~MeshSequenceNode() {  }
+
+    inline virtual void render() override
+    {
+        static const std::vector<std::string> ext = { ".obj" };
+        std::string selected;
+        if(ImGuiExt::FileBrowser(&selected, ext, "Select Frame"))
+        {
+            // The last number of the file name is the frame
+            const std::filesystem::path path(selected);
+            std::string filename = path.filename().string();
+            const size_t end = filename.find_last_of("0123456789");
+            if(end != std::string::npos)
+            {
+                size_t begin = end;
+                while(begin > 0 && std::isdigit((unsigned char)filename[begin - 1])) begin--;
+                filename.replace(begin, end + 1 - begin, end + 1 - begin, '#');
+                strncpy(pattern, (path.parent_path() / filename).string().c_str(), sizeof(pattern) - 1);
+                pattern[sizeof(pattern) - 1] = '\0';
+                detectFrameRange();
+            }
+            else
+            {
+                L_ERROR("Mesh sequence: %s has no frame number.", selected.c_str());
+            }
+            resetRing();
+        }
+
+        if(ImGui::InputText("Pattern", pattern, sizeof(pattern)))
+        {
+            resetRing();
+        }
+        if(ImGui::IsItemHovered())
+        {
+            ImGui::SetTooltip("Frame file names, a run of # is replaced by the zero padded frame number.");
+        }
+
+        if(ImGui::InputInt("First Frame", &first_frame))
+        {
+            last_frame = std::max(last_frame, first_frame);
+        }
+        if(ImGui::InputInt("Last Frame", &last_frame))
+        {
+            first_frame = std::min(last_frame, first_frame);
+        }
+
+        if(ImGui::DragFloat("FPS", &fps, 0.1f, 0.1f, 240.0f, "%.1f"))
+        {
+            fps = std::max(fps, 0.1f);
+        }
+
+        if(ImGui::InputInt("Prefetch", &prefetch))
+        {
+            prefetch = std::clamp(prefetch, 1, MAX_PREFETCH);
+            resizeRing();
+        }
+        if(ImGui::IsItemHovered())
+        {
+            ImGui::SetTooltip("Frames loaded ahead of the current one, only these are kept in memory.\nRenderers also upload them to the GPU before they are shown.");
+        }
+
+        ImGui::Checkbox("Loop", &loop);
+
+        int ready = 0;
+        for(const FrameSlot& slot : ring)
+        {
+            ready += (slot.asset && slot.asset->mesh() != nullptr) ? 1 : 0;
+        }
+        ImGui::Text("Frame: %d (%d/%d loaded)", shown_frame, ready, (int)ring.size());
+        if(missing_frame >= 0)
+        {
+            ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "Error: Frame %d could not be loaded.", missing_frame);
+        }
+    }
+
+    inline virtual void update() override
+    {
+        auto data = outputs[0];
+        data->resetDataUpdate();
+
+        disconnectInputIfNotOfType<float>("t");
+
+        if(pattern[0] == '\0') return;
+
+        auto t_in = inputs_named.find("t");
+        const float t = (t_in != inputs_named.end()) ? t_in->second->getValue<float>() : NodeWindow::GetApptimeMs() / 1000.0f;
+        const int step = (int)std::floor(std::max(t, 0.0f) * fps);
+
+        // The current frame and the next ones are requested, older ring slots get reused
+        // Slots go by playback step, so a wrapped around frame never takes the slot of the current one
+        for(int k = 0; k <= prefetch; k++)
+        {
+            requestFrame(step + k);
+        }
+
+        const int frame = frameAt(step);
+        const FrameSlot& slot = ring[slotOf(step)];
+        const Utils::CachedMeshData* mesh = (slot.frame == frame && slot.asset) ? slot.asset->mesh() : nullptr;
+
+        // The previous frame stays up until this one is loaded
+        if(slot.missing || (mesh != nullptr && mesh->mesh.empty()))
+        {
+            missing_frame = frame;
+        }
+        else if(mesh != nullptr && slot.asset != shown)
+        {
+            shown = slot.asset;
+            shown_frame = frame;
+            missing_frame = -1;
+            shown->view(&vertices_data);
+            vertices_data.prefetch = &prefetch_list;
+            data->setValue(vertices_data);
+        }
+
+        updatePrefetchList(step);
+    }
+
+    inline virtual ByteBuffer serialize() const override
+    {
+        ByteBuffer buffer = PropertyNode::serialize();
+
+        buffer.add(std::string(pattern));
+        buffer.add(first_frame);
+        buffer.add(last_frame);
+        buffer.add(fps);
+        buffer.add(prefetch);
+        buffer.add(loop);
+
+        return buffer;
+    }
+
+    inline virtual void deserialize(ByteBuffer& buffer) override
+    {
+        PropertyNode::deserialize(buffer);
+
+        std::string patterncpy;
+        buffer.get(&patterncpy);
+        strncpy(pattern, patterncpy.c_str(), sizeof(pattern) - 1);
+        pattern[sizeof(pattern) - 1] = '\0';
+
+        buffer.get(&first_frame);
+        buffer.get(&last_frame);
+        buffer.get(&fps);
+        buffer.get(&prefetch);
+        buffer.get(&loop);
+
+        // frameAt divides by the frame count
+        last_frame = std::max(last_frame, first_frame);
+        prefetch = std::clamp(prefetch, 1, MAX_PREFETCH);
+        resizeRing();
+    }
+
+private:
+    struct FrameSlot
+    {
+        int frame = INT_MIN;
+        bool missing = false;
+        std::shared_ptr<const Utils::MeshAsset> asset;
+    };
+
+    inline int frameAt(int step) const
+    {
+        const int count = last_frame - first_frame + 1;
+        if(loop) return first_frame + ((step % count) + count) % count;
+        return first_frame + std::clamp(step, 0, count - 1);
+    }
+
+    inline size_t slotOf(int step) const
+    {
+        return (size_t)step % ring.size();
+    }
+
+    inline std::string framePath(int frame) const
+    {
+        std::string path(pattern);
+        const size_t end = path.find_last_of('#');
+        if(end == std::string::npos) return path;
+
+        size_t begin = end;
+        while(begin > 0 && path[begin - 1] == '#') begin--;
+
+        std::string number = std::to_string(frame);
+        if(number.size() < end + 1 - begin) number.insert(0, end + 1 - begin - number.size(), '0');
+        return path.replace(begin, end + 1 - begin, number);
+    }
+
+    inline void requestFrame(int step)
+    {
+        const int frame = frameAt(step);
+        FrameSlot& slot = ring[slotOf(step)];
+        if(slot.frame == frame) return;
+
+        // A released load would keep running (and its mesh in memory), the ring waits for it instead
+        // so playback outrunning the loads never has more than the ring size in flight
+        if(slot.asset && slot.asset->mesh() == nullptr) return;
+
+        // Replacing the asset releases the frame that was there (the ring bounds the memory used)
+        const std::string path = framePath(frame);
+        slot.frame = frame;
+        slot.missing = !std::filesystem::exists(path);
+        slot.asset = slot.missing ? nullptr : Utils::MeshAssetManager::Acquire(path, false);
+    }
+
+    // Loaded frames after the current one, in playback order
+    inline void updatePrefetchList(int step)
+    {
+        prefetch_list.count = 0;
+        for(int k = 1; k <= prefetch && prefetch_list.count < MeshPrefetchList::MAX_MESHES; k++)
+        {
+            const FrameSlot& slot = ring[slotOf(step + k)];
+            if(slot.frame != frameAt(step + k) || !slot.asset || slot.asset == shown) continue;
+
+            MeshNodeData& mesh = prefetch_list.meshes[prefetch_list.count];
+            if(!slot.asset->view(&mesh) || mesh.data_size == 0) continue;
+
+            // Frames repeat in short loops
+            bool listed = false;
+            for(unsigned int i = 0; i < prefetch_list.count; i++)
+            {
+                listed |= prefetch_list.meshes[i].asset_id == mesh.asset_id;
+            }
+            if(!listed) prefetch_list.count++;
+        }
+    }
+
+    // Frames sharing the pattern in its directory
+    inline void detectFrameRange()
+    {
+        const std::filesystem::path path(pattern);
+        const std::string filename = path.filename().string();
+        const size_t end = filename.find_last_of('#');
+        size_t begin = end;
+        while(begin > 0 && filename[begin - 1] == '#') begin--;
+
+        const std::string prefix = filename.substr(0, begin);
+        const std::string suffix = filename.substr(end + 1);
+
+        int lo = INT_MAX;
+        int hi = INT_MIN;
+        std::error_code ec;
+        for(const auto& entry : std::filesystem::directory_iterator(path.parent_path(), ec))
+        {
+            const std::string name = entry.path().filename().string();
+            if(name.size() <= prefix.size() + suffix.size()) continue;
+            if(name.compare(0, prefix.size(), prefix) != 0) continue;
+            if(name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) continue;
+
+            const std::string number = name.substr(prefix.size(), name.size() - prefix.size() - suffix.size());
+            if(number.find_first_not_of("0123456789") != std::string::npos || number.size() > 9) continue;
+
+            const int frame = std::stoi(number);
+            lo = std::min(lo, frame);
+            hi = std::max(hi, frame);
+        }
+
+        if(lo <= hi)
+        {
+            first_frame = lo;
+            last_frame = hi;
+        }
+    }
+
+    inline void resizeRing()
+    {
+        ring.assign((size_t)prefetch + 1, FrameSlot());
+        prefetch_list.count = 0;
+    }
+
+    inline void resetRing()
+    {
+        resizeRing();
+        missing_frame = -1;
+    }
+
+    char pattern[512];
+    int first_frame = 0;
+    int last_frame = 0;
+    float fps = 24.0f;
+    int prefetch = 4;
+    bool loop = true;
+
+    std::vector<FrameSlot> ring;
+    std::shared_ptr<const Utils::MeshAsset> shown; // Kept until the next frame replaces it
+    int shown_frame = -1;
+    int missing_frame = -1;
+    MeshNodeData vertices_data; // Points into shown
+    MeshPrefetchList prefetch_list; // Points into the ring
+};
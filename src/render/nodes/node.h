@@ -14,6 +14,14 @@
 #include "../../util/serialization.inl"
 #include "../node_outputs.h"
 
+// Scene save file versions, fields appended to an existing node are only read from scenes saved with them
+enum SceneVersion : unsigned int
+{
+    SCENE_VERSION_UNVERSIONED  = 0, // Saves from before the version header
+    SCENE_VERSION_NODE_OPTIONS = 1, // Options appended to existing node layouts
+    SCENE_VERSION_CURRENT      = SCENE_VERSION_NODE_OPTIONS
+};
+
 struct NodeRenderData : public Serializable
 {
     ImVec2 pos;
@@ -145,6 +153,17 @@ struct PropertyGenericData
     // No copy
     PropertyGenericData(const PropertyGenericData& p) = delete;
 
+    // A list view references elements of other list outputs instead of owning them
+    // Each segment takes count elements from source, starting at offset and advancing stride elements
+    // The view reports the type std::vector<T> and is only copied into contiguous storage when getValue() is called
+    struct ListSegment
+    {
+        PropertyGenericData* source = nullptr;
+        size_t offset = 0;
+        size_t count = 0;
+        size_t stride = 1;
+    };
+
     ~PropertyGenericData()
     {
         if(data)
@@ -177,6 +196,10 @@ struct PropertyGenericData
     {
         if(!is_fixed_array)
         {
+            if constexpr(is_std_vector<T>::value)
+            {
+                if(_is_list_view && !_list_view_materialized) materializeListView<typename T::value_type>();
+            }
             return (*(T*)data);
         }
         else
@@ -205,12 +228,19 @@ struct PropertyGenericData
     template<typename T>
     inline T* getValuePtr()
     {
+        if constexpr(is_std_vector<T>::value)
+        {
+            if(_is_list_view && !_list_view_materialized) materializeListView<typename T::value_type>();
+        }
         return ((T*)data);
     }
 
     template<typename T>
     inline void setValue(T value)
     {
+        _is_list_view = false;
+        _list_segments.clear();
+
         if(isOfType<T>())
         {
             if(!is_fixed_array)
@@ -294,10 +324,167 @@ struct PropertyGenericData
         }
     }
 
+    // Resizes the stored list in place (changing the type to std::vector<T> if required)
+    // Avoids the full copy setValue() does when a node writes its output list directly
+    template<typename T>
+    inline std::vector<T>& resizeList(size_t count)
+    {
+        if(!isOfType<std::vector<T>>())
+        {
+            setValue(std::vector<T>());
+        }
+
+        _is_list_view = false;
+        _list_segments.clear();
+
+        std::vector<T>* list = (std::vector<T>*)data;
+        list->resize(count);
+        setSizeForVector<T>();
+        _data_changed = true;
+        return *list;
+    }
+
+    // Turns this data into a view of the given segments (no elements are copied)
+    template<typename T>
+    inline void setListView(const std::vector<ListSegment>& segments)
+    {
+        if(!isOfType<std::vector<T>>())
+        {
+            setValue(std::vector<T>());
+        }
+
+        _list_segments = segments;
+        _is_list_view = true;
+        _list_view_materialized = false;
+        size = sizeof(T) * getListSize();
+        _data_changed = true;
+    }
+
+    // Call when the view sources changed so the next getValue() copies them again
+    inline void invalidateListView()
+    {
+        if(_is_list_view)
+        {
+            _list_view_materialized = false;
+            size = getListElementSize() * getListSize();
+            _data_changed = true;
+        }
+    }
+
+    inline bool isListView() const
+    {
+        return _is_list_view;
+    }
+
+    inline const std::vector<ListSegment>& getListSegments() const
+    {
+        return _list_segments;
+    }
+
+    // Size in bytes of one list element (0 if this does not hold a list)
+    inline size_t getListElementSize()
+    {
+             if(isOfType<std::vector<float>>())        return sizeof(float);
+        else if(isOfType<std::vector<int>>())          return sizeof(int);
+        else if(isOfType<std::vector<unsigned int>>()) return sizeof(unsigned int);
+        else if(isOfType<std::vector<Vector2>>())      return sizeof(Vector2);
+        else if(isOfType<std::vector<Vector3>>())      return sizeof(Vector3);
+        else if(isOfType<std::vector<Vector4>>())      return sizeof(Vector4);
+        return 0;
+    }
+
+    // Element count of the list (views are not materialized)
+    inline size_t getListSize()
+    {
+        if(_is_list_view)
+        {
+            size_t count = 0;
+            for(const auto& s : _list_segments)
+            {
+                count += getSegmentSize(s);
+            }
+            return count;
+        }
+
+             if(isOfType<std::vector<float>>())        return ((std::vector<float>*)data)->size();
+        else if(isOfType<std::vector<int>>())          return ((std::vector<int>*)data)->size();
+        else if(isOfType<std::vector<unsigned int>>()) return ((std::vector<unsigned int>*)data)->size();
+        else if(isOfType<std::vector<Vector2>>())      return ((std::vector<Vector2>*)data)->size();
+        else if(isOfType<std::vector<Vector3>>())      return ((std::vector<Vector3>*)data)->size();
+        else if(isOfType<std::vector<Vector4>>())      return ((std::vector<Vector4>*)data)->size();
+        return 0;
+    }
+
+    // Calls func(first, src, count, stride) for every run of list elements
+    // first is the list index of the run, its elements are src[0], src[stride], ..., src[(count - 1) * stride]
+    // Views are read directly from their sources without being materialized
+    template<typename T, typename F>
+    inline void forEachListSegment(F&& func)
+    {
+        if(!isOfType<std::vector<T>>()) return;
+
+        if(!_is_list_view || _list_view_materialized)
+        {
+            const std::vector<T>& list = *(std::vector<T>*)data;
+            if(!list.empty()) func((size_t)0, (const T*)list.data(), list.size(), (size_t)1);
+            return;
+        }
+
+        size_t first = 0;
+        for(const auto& s : _list_segments)
+        {
+            if(!s.source->isOfType<std::vector<T>>()) continue;
+
+            const size_t count = getSegmentSize(s);
+            if(count == 0) continue;
+
+            // Views of views read from the materialized source
+            const std::vector<T>& source = s.source->getValue<std::vector<T>>();
+            func(first, (const T*)source.data() + s.offset, count, std::max<size_t>(s.stride, 1));
+            first += count;
+        }
+    }
+
+    // Copies all the list elements into dst (must hold getListSize() elements)
+    template<typename T>
+    inline size_t copyListTo(T* dst)
+    {
+        size_t total = 0;
+        forEachListSegment<T>([&](size_t first, const T* src, size_t count, size_t stride) {
+            if(stride == 1)
+            {
+                std::copy(src, src + count, dst + first);
+            }
+            else
+            {
+                for(size_t i = 0; i < count; i++)
+                {
+                    dst[first + i] = src[i * stride];
+                }
+            }
+            total = first + count;
+        });
+        return total;
+    }
+
     inline void* getListData()
     {
         if(is_list)
         {
+            if(_is_list_view && !_list_view_materialized)
+            {
+                switch (vtype)
+                {
+                case ValidType::LIST_FLOAT:   materializeListView<float>(); break;
+                case ValidType::LIST_INT:     materializeListView<int>(); break;
+                case ValidType::LIST_UINT:    materializeListView<unsigned int>(); break;
+                case ValidType::LIST_VECTOR2: materializeListView<Vector2>(); break;
+                case ValidType::LIST_VECTOR3: materializeListView<Vector3>(); break;
+                case ValidType::LIST_VECTOR4: materializeListView<Vector4>(); break;
+                default: break;
+                }
+            }
+
             switch (vtype)
             {
             case ValidType::LIST_FLOAT:   return (void*)((std::vector<float>*)data)->data();
@@ -431,6 +618,28 @@ struct PropertyGenericData
     std::string value_type_name = "No Type";
 
 private:
+    bool _is_list_view = false;
+    bool _list_view_materialized = false;
+    std::vector<ListSegment> _list_segments;
+
+    inline static size_t getSegmentSize(const ListSegment& s)
+    {
+        const size_t source_size = s.source->getListSize();
+        const size_t stride = std::max<size_t>(s.stride, 1);
+        if(s.offset >= source_size) return 0;
+        return std::min(s.count, (source_size - s.offset + stride - 1) / stride);
+    }
+
+    template<typename T>
+    inline void materializeListView()
+    {
+        std::vector<T>* list = (std::vector<T>*)data;
+        list->resize(getListSize());
+        copyListTo<T>(list->data());
+        _list_view_materialized = true;
+        setSizeForVector<T>();
+    }
+
     // template<typename V>
     // inline std::vector<V> createVectorFromData(const TypeDataBuffer& b)
     // {
@@ -510,7 +719,12 @@ struct PropertyNode
         TEST,
         MESHINTERP,
         GRAPH,
-        SHADER
+        SHADER,
+        REDUCE,
+        SLICE,
+        SORT,
+        MESHPALETTE,
+        MESHSEQUENCE
     };
 
     using EmptyType = EmptyTypeDec;
@@ -858,6 +1072,9 @@ struct PropertyNode
         // std::vector<PropertyGenericData*> outputs;
         for(auto o : outputs)
         {
+            // Views only have their final size once materialized
+            if(o->is_list && o->isListView()) o->getListData();
+
             out.add(o->size);
             out.add(o->is_fixed_array);
             out.add(o->is_list);
@@ -18,4 +18,9 @@
 #include "feedback_node.h"
 #include "mesh_interp_node.h"
 #include "hist_node.h"
-#include "shader_node.h"
\ No newline at end of file
+#include "shader_node.h"
+#include "reduce_node.h"
+#include "slice_node.h"
+#include "sort_node.h"
+#include "mesh_palette_node.h"
+#include "mesh_sequence_node.h"
\ No newline at end of file
@@ -0,0 +1,230 @@
+#pragma once
+#include "node.h"
+#include "../../math/vector.h"
+#include "../../math/reduce.inl"
+
+struct ReduceNode final : public PropertyNode
+{
+    enum class Mode
+    {
+        SUM,
+        MIN,
+        MAX,
+        MEAN,
+        AABB,
+        INCLUSIVE_SCAN,
+        EXCLUSIVE_SCAN
+    } mode;
+
+    inline ReduceNode() : PropertyNode(Type::REDUCE, 1, { "list" }, 3, { "result", "min", "max" })
+    {
+        static int inc = 0;
+        name = "Reduce Node #" + std::to_string(inc++);
+        mode = Mode::SUM;
+
+        inputs_description["list"] = "The list to reduce. Vector lists are reduced component wise.";
+
+        setOutputNominalTypes<float, int, unsigned int, Vector2, Vector3, Vector4,
+            std::vector<float>, std::vector<int>, std::vector<unsigned int>, std::vector<Vector2>, std::vector<Vector3>, std::vector<Vector4>
+        >(
+            "result",
+            "The reduced value. The bounds size in AABB mode. A list with the size of the input list in scan modes."
+        );
+
+        setOutputNominalTypes<float, int, unsigned int, Vector2, Vector3, Vector4>(
+            "min",
+            "The lower bound of the list (AABB mode only)."
+        );
+
+        setOutputNominalTypes<float, int, unsigned int, Vector2, Vector3, Vector4>(
+            "max",
+            "The upper bound of the list (AABB mode only)."
+        );
+    }
+
+    ~ReduceNode() {  }
+
+    inline virtual void render() override
+    {
+        static const char* const mode_names[] = {
+            "Sum",
+            "Min",
+            "Max",
+            "Mean",
+            "AABB",
+            "Inclusive Scan",
+            "Exclusive Scan"
+        };
+
+        ImGui::Combo("Mode", &currentmodeid, mode_names, sizeof(mode_names) / sizeof(mode_names[0]));
+        mode = static_cast<Mode>(currentmodeid);
+
+        if(!inputs.empty())
+        {
+            auto data = outputs_named["result"];
+
+            ImGui::BeginDisabled();
+            if(mode == Mode::INCLUSIVE_SCAN || mode == Mode::EXCLUSIVE_SCAN)
+            {
+                ImGui::Text("Result: List [%llu]", (unsigned long long)list_size);
+            }
+            else if(data->isOfType<int>())
+            {
+                ImGui::InputInt("Result", &data->getValue<int>());
+            }
+            else if(data->isOfType<unsigned int>())
+            {
+                ImGui::InputScalar("Result", ImGuiDataType_U32, &data->getValue<unsigned int>());
+            }
+            else if(data->isOfType<float>())
+            {
+                ImGui::InputFloat("Result", &data->getValue<float>());
+            }
+            else if(data->isOfType<Vector2>())
+            {
+                ImGui::InputFloat2("Result", data->getValue<Vector2>().data);
+            }
+            else if(data->isOfType<Vector3>())
+            {
+                ImGui::InputFloat3("Result", data->getValue<Vector3>().data);
+            }
+            else if(data->isOfType<Vector4>())
+            {
+                ImGui::InputFloat4("Result", data->getValue<Vector4>().data);
+            }
+            ImGui::EndDisabled();
+        }
+    }
+
+    inline virtual void update() override
+    {
+        resetOutputsDataUpdate();
+
+        disconnectInputIfNotOfType<
+            std::vector<float>, std::vector<int>, std::vector<unsigned int>, std::vector<Vector2>, std::vector<Vector3>, std::vector<Vector4>
+        >("list");
+
+        auto list_it = inputs_named.find("list");
+        PropertyGenericData* list = (list_it != inputs_named.end()) ? list_it->second : nullptr;
+
+        bool changed = (list != last_list) || (mode != last_mode) || (list && list->dataChanged());
+        last_list = list;
+        last_mode = mode;
+
+        if(!changed || list == nullptr) return;
+
+             if(reduceIfOfType<float>       (list));
+        else if(reduceIfOfType<int>         (list));
+        else if(reduceIfOfType<unsigned int>(list));
+        else if(reduceIfOfType<Vector2>     (list));
+        else if(reduceIfOfType<Vector3>     (list));
+        else if(reduceIfOfType<Vector4>     (list)) {  }
+    }
+
+    inline virtual ByteBuffer serialize() const override
+    {
+        ByteBuffer buffer = PropertyNode::serialize();
+
+        buffer.add(currentmodeid);
+
+        return buffer;
+    }
+
+    inline virtual void deserialize(ByteBuffer& buffer) override
+    {
+        PropertyNode::deserialize(buffer);
+
+        buffer.get(&currentmodeid);
+        mode = static_cast<Mode>(currentmodeid);
+    }
+
+private:
+    int currentmodeid = 0;
+    size_t list_size = 0;
+    PropertyGenericData* last_list = nullptr;
+    Mode last_mode = Mode::SUM;
+
+    template<typename E>
+    inline bool reduceIfOfType(PropertyGenericData* list)
+    {
+        using S = typename Math::ListElementTraits<E>::Scalar;
+        constexpr size_t N = Math::ListElementTraits<E>::Components;
+
+        if(!list->isOfType<std::vector<E>>()) return false;
+
+        const std::vector<E>& src = list->getValue<std::vector<E>>();
+        const S* a = (const S*)src.data();
+        const size_t count = src.size();
+        list_size = count;
+
+        // The op identities (e.g. INT_MAX for MIN) must not leak out of an empty list
+        if(count == 0)
+        {
+            const E zero = E();
+            if(mode == Mode::AABB)
+            {
+                setNamedOutput("min", zero);
+                setNamedOutput("max", zero);
+            }
+
+            if(mode == Mode::INCLUSIVE_SCAN || mode == Mode::EXCLUSIVE_SCAN) outputs_named["result"]->resizeList<E>(0);
+            else if(mode == Mode::MEAN && !std::is_same_v<S, float>)         setNamedOutput("result", 0.0f);
+            else                                                             setNamedOutput("result", zero);
+            return true;
+        }
+
+        E result;
+        switch (mode)
+        {
+            case Mode::SUM:
+                Math::ParallelReduce<Math::ReduceOp::SUM>(a, N, count, (S*)&result);
+                setNamedOutput("result", result);
+                break;
+            case Mode::MIN:
+                Math::ParallelReduce<Math::ReduceOp::MIN>(a, N, count, (S*)&result);
+                setNamedOutput("result", result);
+                break;
+            case Mode::MAX:
+                Math::ParallelReduce<Math::ReduceOp::MAX>(a, N, count, (S*)&result);
+                setNamedOutput("result", result);
+                break;
+            case Mode::MEAN:
+                if constexpr(std::is_same_v<S, float>)
+                {
+                    Math::ParallelReduce<Math::ReduceOp::SUM>(a, N, count, (S*)&result);
+                    for(size_t c = 0; c < N; c++)
+                    {
+                        ((S*)&result)[c] = count > 0 ? ((S*)&result)[c] / (float)count : 0.0f;
+                    }
+                    setNamedOutput("result", result);
+                }
+                else
+                {
+                    // Integer lists output a float mean, summed in 64 bits so large lists do not overflow
+                    double sum;
+                    Math::ParallelWideSum(a, N, count, &sum);
+                    setNamedOutput("result", count > 0 ? (float)(sum / (double)count) : 0.0f);
+                }
+                break;
+            case Mode::AABB:
+            {
+                E lo, hi;
+                Math::ParallelMinMax(a, N, count, (S*)&lo, (S*)&hi);
+                setNamedOutput("min", lo);
+                setNamedOutput("max", hi);
+                setNamedOutput("result", (E)(hi - lo));
+            } break;
+            case Mode::INCLUSIVE_SCAN:
+            {
+                S* out = (S*)outputs_named["result"]->resizeList<E>(count).data();
+                Math::ParallelScan<true>(a, N, count, out);
+            } break;
+            case Mode::EXCLUSIVE_SCAN:
+            {
+                S* out = (S*)outputs_named["result"]->resizeList<E>(count).data();
+                Math::ParallelScan<false>(a, N, count, out);
+            } break;
+        }
+        return true;
+    }
+};
@@ -3,26 +3,32 @@
 #include "mesh_node.h"
 #include "mesh_interp_node.h"
 #include "../node_outputs.h"
+#include "../../math/reduce.inl"
+#include "../../math/instance_pack.inl"
+#include "../../util/parallel.inl"
 #include "../../../glm/glm/gtx/transform.hpp"
-#include "../../../glm/glm/gtx/euler_angles.hpp"
 #include <functional>
 #include <algorithm>
 
 struct RenderNode final : public PropertyNode
 {
-    inline RenderNode() : PropertyNode(Type::RENDER, 5, { "instanceCount", "worldPosition", "worldRotation", "mesh", "colors" }, 1, {})
+    inline RenderNode() : PropertyNode(Type::RENDER, 6, { "instanceCount", "worldPosition", "worldRotation", "mesh", "colors", "meshIndex" }, 1, {})
     {
         static int inc = 0;
 
-        _renderData._worldPositionPtr = (Vector4**)malloc(sizeof(Vector4*));
+        _renderData._worldPositionPtr = (Vector3**)malloc(sizeof(Vector3*));
         *(_renderData._worldPositionPtr) = nullptr;
         L_TRACE("_worldPositionPtr : 0x%X", _renderData._worldPositionPtr);
 
-        _renderData._worldRotationPtr = (glm::mat4**)malloc(sizeof(glm::mat4*));
+        _renderData._worldPositionCompactPtr = (InstancePosition16**)malloc(sizeof(InstancePosition16*));
+        *(_renderData._worldPositionCompactPtr) = nullptr;
+        L_TRACE("_worldPositionCompactPtr : 0x%X", _renderData._worldPositionCompactPtr);
+
+        _renderData._worldRotationPtr = (Vector3**)malloc(sizeof(Vector3*));
         *(_renderData._worldRotationPtr) = nullptr;
         L_TRACE("_worldRotationPtr : 0x%X", _renderData._worldRotationPtr);
 
-        _renderData._instanceColorsPtr = (Vector4**)malloc(sizeof(Vector4*));
+        _renderData._instanceColorsPtr = (InstanceColor8**)malloc(sizeof(InstanceColor8*));
         *(_renderData._instanceColorsPtr) = nullptr;
         L_TRACE("_instanceColorsPtr : 0x%X", _renderData._instanceColorsPtr);
 
@@ -30,9 +36,12 @@ struct RenderNode final : public PropertyNode
         *(_renderData._meshPtr) = nullptr;
         L_TRACE("_meshPtr : 0x%X", _renderData._meshPtr);
 
-        _renderData._motifPositionPtr = (glm::mat4**)malloc(sizeof(glm::mat4*));
-        *(_renderData._motifPositionPtr) = nullptr;
-        L_TRACE("_motifPositionPtr : 0x%X", _renderData._motifPositionPtr);
+        _renderData._meshIndexPtr = (unsigned int**)malloc(sizeof(unsigned int*));
+        *(_renderData._meshIndexPtr) = nullptr;
+        L_TRACE("_meshIndexPtr : 0x%X", _renderData._meshIndexPtr);
+
+        _renderData._instanceDirty = &_instanceDirtyRanges;
+        _renderData._streamSlot = &_streamSlot;
 
         name = "Render Node #" + std::to_string(inc++);
         priority = PropertyNode::Priority::RENDER;
@@ -60,7 +69,12 @@ struct RenderNode final : public PropertyNode
 
         inputs_description["mesh"] = 
             "The mesh the current motif uses to render objects. "
-            "If linked, must be a obj mesh file or a list of meshes (for interpolation scenarios)."
+            "If linked, must be a obj mesh file or a list of meshes (for interpolation scenarios, or a palette with \"meshIndex\")."
+        ;
+
+        inputs_description["meshIndex"] = 
+            "The palette mesh each instance of the current motif draws (needs a list of meshes on \"mesh\", e.g. from a Mesh Palette Node). "
+            "If linked, must be equal to the size of the \"worldPosition\" list."
         ;
 
 
@@ -80,6 +94,11 @@ struct RenderNode final : public PropertyNode
             free(_renderData._worldPositionPtr);
         }
 
+        if(_renderData._worldPositionCompactPtr != nullptr)
+        {
+            free(_renderData._worldPositionCompactPtr);
+        }
+
         if(_renderData._worldRotationPtr != nullptr)
         {
             free(_renderData._worldRotationPtr);
@@ -95,10 +114,11 @@ struct RenderNode final : public PropertyNode
             free(_renderData._meshPtr);
         }
 
-        if(_renderData._motifPositionPtr != nullptr)
+        if(_renderData._meshIndexPtr != nullptr)
         {
-            free(_renderData._motifPositionPtr);
+            free(_renderData._meshIndexPtr);
         }
+
         L_TRACE("~RenderNode()");
     }
 
@@ -148,20 +168,15 @@ struct RenderNode final : public PropertyNode
             if(_motif_changed_internal)
             {
                 auto worldPositionLocal = inputs_named.find("worldPosition");
-                if(worldPositionLocal != inputs_named.end())
+                if(worldPositionLocal != inputs_named.end() && !worldPositionLocal->second->getValue<std::vector<Vector3>>().empty())
                 {
-                    auto data = worldPositionLocal->second->getValue<std::vector<Vector3>>().data();
-                    float maxx = positionMaxFromArray(data, 0);
-                    float maxy = positionMaxFromArray(data, 1);
-                    float maxz = positionMaxFromArray(data, 2);
-
-                    float minx = positionMinFromArray(data, 0);
-                    float miny = positionMinFromArray(data, 1);
-                    float minz = positionMinFromArray(data, 2);
+                    auto& data = worldPositionLocal->second->getValue<std::vector<Vector3>>();
+                    Vector3 min, max;
+                    Math::ParallelMinMax(data.data()->data, 3, data.size(), min.data, max.data);
 
-                    float spanx = std::abs(maxx - minx) * 2.0f;
-                    float spany = std::abs(maxy - miny) * 2.0f;
-                    float spanz = std::abs(maxz - minz) * 2.0f;
+                    float spanx = std::abs(max.x - min.x) * 2.0f;
+                    float spany = std::abs(max.y - min.y) * 2.0f;
+                    float spanz = std::abs(max.z - min.z) * 2.0f;
 
                     L_DEBUG("Data span (x, y, z): (%.1f, %.1f, %.1f)", spanx, spany, spanz);
 
@@ -171,6 +186,61 @@ struct RenderNode final : public PropertyNode
                 }
             }
 
+            ImGui::BeginDisabled(!streamAvailable());
+            if(ImGui::Checkbox("Stream Instances", &_renderData._streamInstances))
+            {
+                outputs[0]->setValue(_renderData);
+            }
+            ImGui::EndDisabled();
+            if(ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled))
+            {
+                ImGui::SetTooltip("Write every instance each frame directly into mapped GPU memory. For scenes that change every frame. Not used with a mesh palette (its instances are grouped by mesh).");
+            }
+
+            if(ImGui::Checkbox("Cull Instances", &_renderData._cullInstances))
+            {
+                outputs[0]->setValue(_renderData);
+            }
+            if(ImGui::IsItemHovered())
+            {
+                ImGui::SetTooltip("Only upload and draw the instances inside the view frustum. Not used with streamed instances or motif repetition.");
+            }
+
+            if(ImGui::Checkbox("Compact Positions", &_renderData._compactPositions))
+            {
+                _compact_positions_changed = true;
+            }
+            if(ImGui::IsItemHovered())
+            {
+                ImGui::SetTooltip("Upload positions quantized to 16 bits inside the instances bounds.");
+            }
+
+            if(ImGui::Checkbox("Compact Vertices", &_renderData._compactVertices))
+            {
+                outputs[0]->setValue(_renderData);
+            }
+            if(ImGui::IsItemHovered())
+            {
+                ImGui::SetTooltip("Upload mesh vertices as 16 bit positions inside the mesh bounds and octahedral normals (12 instead of 24 bytes).");
+            }
+
+            if(ImGui::Checkbox("Mesh LOD", &_renderData._meshLod))
+            {
+                outputs[0]->setValue(_renderData);
+            }
+            if(ImGui::IsItemHovered())
+            {
+                ImGui::SetTooltip("Draw distant instances with the simplified mesh levels. Not used with streamed instances, motif repetition or interpolated meshes.");
+            }
+
+            if(_renderData._meshLod)
+            {
+                if(ImGui::DragFloat("LOD Pixel Error", &_renderData._lodPixelError, 0.05f, 0.1f, 16.0f, "%.2f"))
+                {
+                    outputs[0]->setValue(_renderData);
+                }
+            }
+
             if(_renderData._repeatBlocks)
             {
                 if(ImGui::InputFloat3("Motif Size", _renderData._motifSize.data, "%.1f"))
@@ -197,47 +267,12 @@ struct RenderNode final : public PropertyNode
             _renderData._motifInstances[1] = (unsigned int)std::ceil(_renderData._fogMax / _renderData._motifSize.y);
             _renderData._motifInstances[2] = (unsigned int)std::ceil(_renderData._fogMax / _renderData._motifSize.z);
             
-            _renderData._motif_span = (_renderData._motifInstances[0] + 1) *
-                                      (_renderData._motifInstances[1] + 1) *
-                                      (_renderData._motifInstances[2] + 1) * 8;
-
-            glm::mat4* motifPosLocal = *(_renderData._motifPositionPtr);
-            if(motifPosLocal != nullptr)
-            {
-                delete[] motifPosLocal;
-            }
-            motifPosLocal = new glm::mat4[_renderData._motif_span * _renderData._instanceCount];
-
-            int span_x = (int)_renderData._motifInstances[0];
-            int span_y = (int)_renderData._motifInstances[1];
-            int span_z = (int)_renderData._motifInstances[2];
-
-            for(int i = 0; i < (int)_renderData._instanceCount; i++)
-            {
-                int o = i * _renderData._motif_span;
-                for(int z = -span_z; z < span_z + 1; z++)
-                {
-                    for(int y = -span_y; y < span_y + 1; y++)
-                    {
-                        for(int x = -span_x; x < span_x + 1; x++)
-                        {
-                            int idx = (x + span_x) + (y + span_y) * 2 * span_x + (z + span_z) * 4 * span_x * span_y;
-                            motifPosLocal[o + idx] = glm::translate(
-                                glm::vec3(
-                                    _renderData._motifSize.x * x,
-                                    _renderData._motifSize.y * y,
-                                    _renderData._motifSize.z * z
-                                )
-                            );
-                        }
-                    }
-                }
-            }
-
-            *(_renderData._motifPositionPtr) = motifPosLocal;
+            // Tiles span [-n, n] on each axis, the vertex shader places them from gl_InstanceID
+            _renderData._motif_span = (2 * _renderData._motifInstances[0] + 1) *
+                                      (2 * _renderData._motifInstances[1] + 1) *
+                                      (2 * _renderData._motifInstances[2] + 1);
 
             L_DEBUG("New Motif Instances: (%u, %u, %u)", _renderData._motifInstances[0], _renderData._motifInstances[1], _renderData._motifInstances[2]);
-            L_DEBUG("Motif Instance Attr size: %d kb", _renderData._motif_span * _renderData._instanceCount * sizeof(glm::mat4) / 1024);
             L_DEBUG("New Total Instance Count: %u", _renderData._motif_span * _renderData._instanceCount);
             _renderData._motifChanged = true;
             outputs[0]->setValue(_renderData);
@@ -298,7 +333,8 @@ struct RenderNode final : public PropertyNode
                 "worldPosition",
                 "worldRotation",
                 "mesh",
-                "colors"
+                "colors",
+                "meshIndex"
             });
         }
         break;
@@ -310,6 +346,7 @@ struct RenderNode final : public PropertyNode
             disconnectInputIfNotOfType<EmptyType>("worldRotation");
             disconnectInputIfNotOfType<EmptyType>("mesh");
             disconnectInputIfNotOfType<EmptyType>("colors");
+            disconnectInputIfNotOfType<EmptyType>("meshIndex");
 
             setInputsOrdered({
                 "shader"
@@ -329,244 +366,106 @@ struct RenderNode final : public PropertyNode
         disconnectInputIfNotOfType<std::vector<Vector3>>("worldRotation");
         disconnectInputIfNotOfType<MeshNodeData, MeshInterpListData>("mesh");
         disconnectInputIfNotOfType<std::vector<Vector4>>("colors");
+        disconnectInputIfNotOfType<std::vector<unsigned int>, std::vector<int>>("meshIndex");
 
         // Instance Count Handling
         auto instanceCountLocal = inputs_named.find("instanceCount");
-        if(instanceCountLocal == inputs_named.end())
+        unsigned int instanceCount = 1;
+        if(instanceCountLocal != inputs_named.end())
         {
-            _instanceCountLast = 1;
-            if(_instanceCountLast != _renderData._instanceCount)
-            {
-                _renderData._instanceCount = _instanceCountLast;
+            instanceCount = instanceCountLocal->second->getValue<unsigned int>();
+        }
 
-                Vector4* worldPosLocal = *(_renderData._worldPositionPtr);
-                if(worldPosLocal != nullptr)
-                {
-                    delete[] worldPosLocal;
-                }
-                worldPosLocal = new Vector4[_instanceCountLast];
+        auto worldPositionLocal = inputs_named.find("worldPosition");
+        PropertyGenericData* worldPositions = (worldPositionLocal != inputs_named.end()) ? worldPositionLocal->second : nullptr;
 
-                auto worldPositionLocal = inputs_named.find("worldPosition");
-                if(worldPositionLocal != inputs_named.end())
-                {
-                    auto worldPositions = worldPositionLocal->second->getValue<std::vector<Vector3>>();
-                    worldPosLocal[0] = Vector4(
-                        worldPositions[0].x, 
-                        worldPositions[0].y,
-                        worldPositions[0].z,
-                        0.0f
-                    );
-                }
-                else
-                {
-                    worldPosLocal[0] = Vector4(0.0f, 0.0f, 0.0f, 0.0f);
-                }
+        auto worldRotationLocal = inputs_named.find("worldRotation");
+        PropertyGenericData* worldRotations = (worldRotationLocal != inputs_named.end()) ? worldRotationLocal->second : nullptr;
 
-                Vector4* instanceColorLocal = *(_renderData._instanceColorsPtr);
-                if(instanceColorLocal != nullptr)
-                {
-                    delete[] instanceColorLocal;
-                }
-                instanceColorLocal = new Vector4[_instanceCountLast];
+        auto colorLocal = inputs_named.find("colors");
+        PropertyGenericData* colors = (colorLocal != inputs_named.end()) ? colorLocal->second : nullptr;
 
-                auto colorLocal = inputs_named.find("colors");
-                if(colorLocal != inputs_named.end())
-                {
-                    auto colors = colorLocal->second->getValue<std::vector<Vector4>>();
-                    instanceColorLocal[0] = colors[0];
-                }
-                else
-                {
-                    instanceColorLocal[0] = Vector4(1, 1, 1, 1);
-                }
+        auto meshIndexLocal = inputs_named.find("meshIndex");
+        PropertyGenericData* meshIndices = (meshIndexLocal != inputs_named.end()) ? meshIndexLocal->second : nullptr;
 
-                glm::mat4* worldRotationLocal = *(_renderData._worldRotationPtr);
-                if(worldRotationLocal != nullptr)
-                {
-                    delete[] worldRotationLocal;
-                }
-                worldRotationLocal = new glm::mat4[_instanceCountLast];
-
-                auto rotationLocal = inputs_named.find("worldRotation");
-                if(rotationLocal != inputs_named.end())
-                {
-                    auto rots = rotationLocal->second->getValue<std::vector<Vector4>>();
-                    worldRotationLocal[0] = glm::eulerAngleYXZ(rots[0].y, rots[0].x, rots[0].z);
-                }
-                else
-                {
-                    worldRotationLocal[0] = glm::mat4(1.0f);
-                }
+        // Streaming: write straight into the slot the renderer handed over, if it fits
+        bool streamed = false;
+        if(_renderData._streamInstances && streamAvailable())
+        {
+            _streamSlot.requested = instanceCount;
+            streamed = (_streamSlot.positions != nullptr && _streamSlot.capacity >= instanceCount);
+        }
 
+        if(streamed)
+        {
+            if(_instanceCountLast != instanceCount)
+            {
+                _instanceCountLast = instanceCount;
+                _renderData._instanceCount = instanceCount;
                 _render_data_changed = true;
-                *(_renderData._worldPositionPtr) = worldPosLocal;
-                *(_renderData._instanceColorsPtr) = instanceColorLocal;
-                *(_renderData._worldRotationPtr) = worldRotationLocal;
                 outputs[0]->setValue(_renderData);
             }
-        }
-        else
-        {
-            unsigned int instanceCount = instanceCountLocal->second->getValue<unsigned int>();
-            auto worldPositionLocal = inputs_named.find("worldPosition");
-            bool worldPositionOkay = true;
 
-            auto worldRotationLocal = inputs_named.find("worldRotation");
-            bool worldRotationOkay = true;
-
-            auto colorLocal = inputs_named.find("colors");
-            bool colorOkay = true;
-
-            if(colorLocal == inputs_named.end())
+            // The positions are not read back from the slot
+            if(_renderData._instanceBoundsValid)
             {
-                colorOkay = false;
+                _renderData._instanceBoundsValid = false;
+                outputs[0]->setValue(_renderData);
             }
-            else
-            {
-                if(colorLocal->second->dataChanged())
-                {
-                    auto colors = colorLocal->second->getValue<std::vector<Vector4>>();
-                    Vector4* color = *(_renderData._instanceColorsPtr);
 
-                    if(_renderData._instanceCount > 0)
-                        memcpy(color, colors.data(), colors.size() * sizeof(Vector4));
+            streamInstances(worldPositions, worldRotations, colors);
 
-                    *(_renderData._instanceColorsPtr) = color;
-                    outputs[0]->setDataChanged();
-                }
-            }
+            // The slot is only valid for this frame
+            _streamSlot.positions = nullptr;
+            _streamSlot.rotations = nullptr;
+            _streamSlot.colors = nullptr;
+            _streamSlot.written = true;
 
-            if(worldPositionLocal == inputs_named.end())
+            // The local arrays were not kept up to date
+            _instance_arrays_stale = true;
+        }
+        else if(_instanceCountLast != instanceCount || _compact_positions_changed || _instance_arrays_stale)
+        {
+            _compact_positions_changed = false;
+            _instance_arrays_stale = false;
+            _instanceCountLast = instanceCount;
+            _renderData._instanceCount = instanceCount;
+
+            allocateInstanceData(instanceCount);
+            writePositions(worldPositions);
+            writeRotations(worldRotations);
+            writeColors(colors);
+            writeMeshIndices(meshIndices);
+
+            _render_data_changed = true;
+            outputs[0]->setValue(_renderData);
+        }
+        else
+        {
+            if(colors && colors->dataChanged())
             {
-                worldPositionOkay = false;
+                writeColors(colors);
+                outputs[0]->setDataChanged();
             }
-            else
-            {
-                if(worldPositionLocal->second->dataChanged())
-                {
-                    auto worldPositions = worldPositionLocal->second->getValue<std::vector<Vector3>>();
-                    Vector4* worldPosLocal = *(_renderData._worldPositionPtr);
 
-                    for(unsigned int i = 0; i < _renderData._instanceCount; i++)
-                    {
-                        worldPosLocal[i] = Vector4(
-                            worldPositions[i].x, 
-                            worldPositions[i].y,
-                            worldPositions[i].z,
-                            0.0f
-                        );
-                    }
+            if(worldPositions && worldPositions->dataChanged())
+            {
+                writePositions(worldPositions);
 
-                    *(_renderData._worldPositionPtr) = worldPosLocal;
-                    outputs[0]->setDataChanged();
-                }
+                // The bounds used for quantization might have changed
+                outputs[0]->setValue(_renderData);
             }
 
-            if(worldRotationLocal == inputs_named.end())
+            if(worldRotations && worldRotations->dataChanged())
             {
-                worldRotationOkay = false;
+                writeRotations(worldRotations);
+                outputs[0]->setDataChanged();
             }
-            else
-            {
-                if(worldRotationLocal->second->dataChanged())
-                {
-                    auto worldRotations = worldRotationLocal->second->getValue<std::vector<Vector3>>();
-                    glm::mat4* worldRotLocal = *(_renderData._worldRotationPtr);
-
-                    for(unsigned int i = 0; i < _renderData._instanceCount; i++)
-                    {
-                        worldRotLocal[i] = glm::eulerAngleYXZ(worldRotations[i].y, worldRotations[i].x, worldRotations[i].z);
-                    }
 
-                    *(_renderData._worldRotationPtr) = worldRotLocal;
-                    outputs[0]->setDataChanged();
-                }
-            }
-
-            if(_instanceCountLast != instanceCount)
+            if(meshIndices != _meshIndicesLast || (meshIndices && meshIndices->dataChanged()))
             {
-                _renderData._instanceCount = instanceCount;
-                
-                Vector4* worldPosLocal = *(_renderData._worldPositionPtr);
-                if(worldPosLocal != nullptr)
-                {
-                    delete[] worldPosLocal;
-                }
-                worldPosLocal = new Vector4[instanceCount];
-
-                if(worldPositionOkay)
-                {
-                    auto worldPositions = worldPositionLocal->second->getValue<std::vector<Vector3>>();
-
-                    for(unsigned int i = 0; i < _renderData._instanceCount; i++)
-                    {
-                        worldPosLocal[i] = Vector4(
-                            worldPositions[i].x, 
-                            worldPositions[i].y,
-                            worldPositions[i].z,
-                            0.0f
-                        );
-                    }
-                }
-                else
-                {
-                    for(unsigned int i = 0; i < _renderData._instanceCount; i++)
-                    {
-                        worldPosLocal[i] = Vector4(0.0f, 0.0f, 0.0f, 0.0f);
-                    }
-                }
-
-                glm::mat4* worldRotLocal = *(_renderData._worldRotationPtr);
-                if(worldRotLocal != nullptr)
-                {
-                    delete[] worldRotLocal;
-                }
-                worldRotLocal = new glm::mat4[instanceCount];
-
-                if(worldRotationOkay)
-                {
-                    auto worldRotations = worldRotationLocal->second->getValue<std::vector<Vector3>>();
-
-                    for(unsigned int i = 0; i < _renderData._instanceCount; i++)
-                    {
-                        worldRotLocal[i] = glm::eulerAngleYXZ(worldRotations[i].y, worldRotations[i].x, worldRotations[i].z);
-                    }
-                }
-                else
-                {
-                    for(unsigned int i = 0; i < _renderData._instanceCount; i++)
-                    {
-                        worldRotLocal[i] = glm::mat4(1.0f);
-                    }
-                }
-
-                Vector4* colors = *(_renderData._instanceColorsPtr);
-                if(colors != nullptr)
-                {
-                    delete[] colors;
-                }
-                colors = new Vector4[instanceCount];
-
-                if(colorOkay)
-                {
-                    auto color = colorLocal->second->getValue<std::vector<Vector4>>();
-                    memcpy(colors, color.data(), instanceCount * sizeof(Vector4));
-                }
-                else
-                {
-                    for(unsigned int i = 0; i < _renderData._instanceCount; i++)
-                    {
-                        colors[i] = Vector4(1, 1, 1, 1);
-                    }
-                }
-
-                _instanceCountLast = instanceCount;
-                _render_data_changed = true;
-                *(_renderData._worldPositionPtr) = worldPosLocal;
-                *(_renderData._worldRotationPtr) = worldRotLocal;
-                *(_renderData._instanceColorsPtr) = colors;
-
-                outputs[0]->setValue(_renderData);
+                writeMeshIndices(meshIndices);
+                outputs[0]->setDataChanged();
             }
         }
 
@@ -574,7 +473,9 @@ struct RenderNode final : public PropertyNode
         auto meshLocal = inputs_named.find("mesh");
         if(meshLocal != inputs_named.end())
         {
-            if(meshLocal->second->dataChanged() || *(_renderData._meshPtr) == nullptr)
+            // A list of meshes is a palette when the instances pick their mesh
+            const bool palette = meshLocal->second->isOfType<MeshInterpListData>() && meshIndices != nullptr;
+            if(meshLocal->second->dataChanged() || *(_renderData._meshPtr) == nullptr || palette != _renderData._meshPalette)
             {
                 // We have a new mesh for displaying
                 // Handle it
@@ -588,6 +489,7 @@ struct RenderNode final : public PropertyNode
                         *(_renderData._meshPtr) = newMeshPtr;
                         _renderData._meshCount = 1;
                         _renderData._meshParam = 0.0f;
+                        _renderData._meshPalette = false;
                         outputs[0]->setValue(_renderData);
                     }
                 }
@@ -596,7 +498,16 @@ struct RenderNode final : public PropertyNode
                     auto newMeshListPtr = meshLocal->second->getValuePtr<MeshInterpListData>();
                     if(newMeshListPtr->meshes.size() > 0)
                     {
-                        if(newMeshListPtr->changeParamOnly)
+                        if(palette)
+                        {
+                            _render_data_changed = true;
+                            *(_renderData._meshPtr) = newMeshListPtr->meshes.data();
+                            _renderData._meshCount = (unsigned int)newMeshListPtr->meshes.size();
+                            _renderData._meshParam = 0.0f;
+                            _renderData._meshPalette = true;
+                            outputs[0]->setValue(_renderData);
+                        }
+                        else if(newMeshListPtr->changeParamOnly)
                         {
                             _renderData._meshParam = newMeshListPtr->t;
                             outputs[0]->setValue(_renderData);
@@ -607,6 +518,7 @@ struct RenderNode final : public PropertyNode
                             *(_renderData._meshPtr) = newMeshListPtr->meshes.data();
                             _renderData._meshCount = newMeshListPtr->meshes.size();
                             _renderData._meshParam = newMeshListPtr->t;
+                            _renderData._meshPalette = false;
                             outputs[0]->setValue(_renderData);
                         }
                     }
@@ -615,6 +527,208 @@ struct RenderNode final : public PropertyNode
         }
     }
 
+    inline void allocateInstanceData(unsigned int count)
+    {
+        delete[] *(_renderData._worldPositionPtr);
+        delete[] *(_renderData._worldPositionCompactPtr);
+        delete[] *(_renderData._worldRotationPtr);
+        delete[] *(_renderData._instanceColorsPtr);
+        delete[] *(_renderData._meshIndexPtr);
+
+        *(_renderData._worldPositionPtr) = new Vector3[count];
+        *(_renderData._worldPositionCompactPtr) = _renderData._compactPositions ? new InstancePosition16[count]() : nullptr;
+        *(_renderData._worldRotationPtr) = new Vector3[count];
+        *(_renderData._instanceColorsPtr) = new InstanceColor8[count]();
+        *(_renderData._meshIndexPtr) = new unsigned int[count]();
+
+        // New storage, everything needs to be uploaded again
+        _instanceDirtyRanges.all(count);
+    }
+
+    // Instances are converted in blocks, the threads handle contiguous instance ranges
+    static constexpr size_t INSTANCE_BLOCK = 256;
+    static constexpr size_t INSTANCE_MIN_PER_THREAD = 1 << 14;
+
+    // Runs fill(D* out, size_t first, size_t n) over every instance block in parallel
+    // With dirty tracking, blocks are filled into a scratch buffer and only copied (and marked) when they differ from dst
+    // Without it (mapped memory) blocks are filled in place, dst is never read
+    template<typename D, typename F>
+    inline void fillInstanceBlocks(D* dst, F fill, InstanceDirtyRange* dirty)
+    {
+        const size_t count = _renderData._instanceCount;
+        const size_t chunks = Utils::GetParallelChunkCount(count, INSTANCE_MIN_PER_THREAD);
+        std::vector<InstanceDirtyRange> ranges(chunks);
+
+        Utils::ParallelForChunks(count, chunks, [&](size_t chunk, size_t begin, size_t end) {
+            D block[INSTANCE_BLOCK];
+            for(size_t first = begin; first < end; first += INSTANCE_BLOCK)
+            {
+                const size_t n = std::min(INSTANCE_BLOCK, end - first);
+                if(dirty == nullptr)
+                {
+                    fill(dst + first, first, n);
+                }
+                else
+                {
+                    fill(block, first, n);
+                    if(memcmp(block, dst + first, n * sizeof(D)) != 0)
+                    {
+                        memcpy(dst + first, block, n * sizeof(D));
+                        ranges[chunk].add((unsigned int)first, (unsigned int)(first + n));
+                    }
+                }
+            }
+        });
+
+        if(dirty != nullptr)
+        {
+            for(const auto& r : ranges) dirty->add(r.begin, r.end);
+        }
+    }
+
+    // Converts the input list into dst, convert(const T* src, size_t stride, D* out, size_t n) converts n instances
+    // The input lists might be views (e.g. from a List Join Node)
+    // Read them segment by segment instead of having them copied into contiguous lists first
+    // Instances past the end of the input list get the default value
+    template<typename T, typename D, typename C>
+    inline void writeInstanceList(PropertyGenericData* list, D* dst, const D& def, C convert, InstanceDirtyRange* dirty)
+    {
+        struct Segment
+        {
+            size_t first;
+            const T* src;
+            size_t count;
+            size_t stride;
+        };
+
+        const size_t count = _renderData._instanceCount;
+        std::vector<Segment> segments;
+        if(list != nullptr)
+        {
+            list->forEachListSegment<T>([&](size_t first, const T* src, size_t n, size_t stride) {
+                if(first < count && n > 0) segments.push_back({ first, src, std::min(n, count - first), stride });
+            });
+        }
+
+        fillInstanceBlocks(dst, [&](D* out, size_t first, size_t n) {
+            const size_t end = first + n;
+            size_t i = first;
+            for(const Segment& s : segments)
+            {
+                if(s.first + s.count <= i) continue;
+                if(s.first >= end || s.first > i) break;
+                const size_t m = std::min(end, s.first + s.count) - i;
+                convert(s.src + (i - s.first) * s.stride, s.stride, out + (i - first), m);
+                i += m;
+            }
+            std::fill(out + (i - first), out + n, def);
+        }, dirty);
+    }
+
+    static inline void copyVectors(const Vector3* src, size_t stride, Vector3* out, size_t n)
+    {
+        if(stride == 1)
+        {
+            memcpy(out, src, n * sizeof(Vector3));
+        }
+        else for(size_t i = 0; i < n; i++)
+        {
+            out[i] = src[i * stride];
+        }
+    }
+
+    // Negative indices select the first mesh
+    template<typename T>
+    static inline void copyIndices(const T* src, size_t stride, unsigned int* out, size_t n)
+    {
+        for(size_t i = 0; i < n; i++)
+        {
+            T v = src[i * stride];
+            out[i] = v > 0 ? (unsigned int)v : 0u;
+        }
+    }
+
+    static inline void packColors(const Vector4* src, size_t stride, InstanceColor8* out, size_t n)
+    {
+        if(stride == 1)
+        {
+            Math::PackColorsRGBA8(src->data, (uint8_t*)out, n);
+        }
+        else for(size_t i = 0; i < n; i++)
+        {
+            const Vector4& c = src[i * stride];
+            out[i] = InstanceColor8{ Math::PackUnorm8(c.x), Math::PackUnorm8(c.y), Math::PackUnorm8(c.z), Math::PackUnorm8(c.w) };
+        }
+    }
+
+    inline void streamInstances(PropertyGenericData* positions, PropertyGenericData* rotations, PropertyGenericData* colors)
+    {
+        writeInstanceList<Vector3>(positions, _streamSlot.positions, Vector3(0.0f, 0.0f, 0.0f), copyVectors, nullptr);
+        writeInstanceList<Vector3>(rotations, _streamSlot.rotations, Vector3(0.0f, 0.0f, 0.0f), copyVectors, nullptr);
+        writeInstanceList<Vector4>(colors, _streamSlot.colors, InstanceColor8{ 255, 255, 255, 255 }, packColors, nullptr);
+    }
+
+    inline void writePositions(PropertyGenericData* list)
+    {
+        Vector3* positions = *(_renderData._worldPositionPtr);
+        InstanceDirtyRange changed;
+        writeInstanceList<Vector3>(list, positions, Vector3(0.0f, 0.0f, 0.0f), copyVectors, &changed);
+
+        const size_t count = _renderData._instanceCount;
+        Vector3 min, max;
+        Math::ParallelMinMax(positions->data, 3, count, min.data, max.data);
+        _renderData._instanceBoundsValid = count > 0;
+        _renderData._instanceBoundsMin = min;
+        _renderData._instanceBoundsMax = max;
+
+        if(!_renderData._compactPositions)
+        {
+            _renderData._positionOrigin = Vector3(0.0f, 0.0f, 0.0f);
+            _renderData._positionExtent = Vector3(1.0f, 1.0f, 1.0f);
+            _instanceDirtyRanges.position.add(changed.begin, changed.end);
+            return;
+        }
+
+        Vector3 scale;
+        for(int c = 0; c < 3; c++)
+        {
+            float extent = max.data[c] - min.data[c];
+            scale.data[c] = extent > 0.0f ? 65535.0f / extent : 0.0f;
+            _renderData._positionExtent.data[c] = extent;
+        }
+        _renderData._positionOrigin = min;
+
+        // The bounds might have moved, so every quantized position is recomputed (but only the changed ones are uploaded)
+        InstancePosition16* compact = *(_renderData._worldPositionCompactPtr);
+        fillInstanceBlocks(compact, [&](InstancePosition16* out, size_t first, size_t n) {
+            Math::QuantizePositions16(positions[first].data, min.data, scale.data, (uint16_t*)out, n);
+        }, &_instanceDirtyRanges.position);
+    }
+
+    inline void writeMeshIndices(PropertyGenericData* list)
+    {
+        _meshIndicesLast = list;
+        unsigned int* indices = *(_renderData._meshIndexPtr);
+        if(list != nullptr && list->isOfType<std::vector<int>>())
+        {
+            writeInstanceList<int>(list, indices, 0u, copyIndices<int>, &_instanceDirtyRanges.mesh);
+        }
+        else
+        {
+            writeInstanceList<unsigned int>(list, indices, 0u, copyIndices<unsigned int>, &_instanceDirtyRanges.mesh);
+        }
+    }
+
+    inline void writeRotations(PropertyGenericData* list)
+    {
+        writeInstanceList<Vector3>(list, *(_renderData._worldRotationPtr), Vector3(0.0f, 0.0f, 0.0f), copyVectors, &_instanceDirtyRanges.rotation);
+    }
+
+    inline void writeColors(PropertyGenericData* list)
+    {
+        writeInstanceList<Vector4>(list, *(_renderData._instanceColorsPtr), InstanceColor8{ 255, 255, 255, 255 }, packColors, &_instanceDirtyRanges.color);
+    }
+
     inline void update_raymarch()
     {
         outputs[0]->resetDataUpdate();
@@ -672,6 +786,13 @@ struct RenderNode final : public PropertyNode
         buffer.add(_renderData._motifSize.y);
         buffer.add(_renderData._motifSize.z);
 
+        buffer.add(_renderData._compactPositions);
+        buffer.add(_renderData._streamInstances);
+        buffer.add(_renderData._cullInstances);
+        buffer.add(_renderData._compactVertices);
+        buffer.add(_renderData._meshLod);
+        buffer.add(_renderData._lodPixelError);
+
         return buffer;
     }
 
@@ -693,6 +814,17 @@ struct RenderNode final : public PropertyNode
         buffer.get(&_renderData._motifSize.y);
         buffer.get(&_renderData._motifSize.z);
 
+        // Options from after the unversioned layout
+        if(buffer.getVersion() >= SCENE_VERSION_NODE_OPTIONS)
+        {
+            buffer.get(&_renderData._compactPositions);
+            buffer.get(&_renderData._streamInstances);
+            buffer.get(&_renderData._cullInstances);
+            buffer.get(&_renderData._compactVertices);
+            buffer.get(&_renderData._meshLod);
+            buffer.get(&_renderData._lodPixelError);
+        }
+
         _renderData._fogChanged = true;
 
         // Resetup this node
@@ -702,6 +834,14 @@ struct RenderNode final : public PropertyNode
     }
 
 private:
+    // Streamed instances stay in input order, a mesh palette draws them grouped by mesh
+    inline bool streamAvailable()
+    {
+        auto meshLocal = inputs_named.find("mesh");
+        const bool palette = meshLocal != inputs_named.end() && meshLocal->second->isOfType<MeshInterpListData>() && inputs_named.find("meshIndex") != inputs_named.end();
+        return !palette;
+    }
+
     inline void renderSubMenu(const char* name, ImVec4 color, bool* flag, std::function<void()> func)
     {
         static std::unordered_map<std::string, int> id;
@@ -767,36 +907,17 @@ private:
         );
     }
 
-    inline float positionMaxFromArray(const Vector3* data, int offset)
-    {
-        const float* fdata = data->data;
-        constexpr int stride = 3;
-        float max = fdata[offset];
-        for(int i = offset + stride; i < _renderData._instanceCount * stride; i += stride)
-        {
-            if(fdata[i] > max) max = fdata[i];
-        }
-        return max;
-    }
-
-    inline float positionMinFromArray(const Vector3* data, int offset)
-    {
-        const float* fdata = data->data;
-        constexpr int stride = 3;
-        float min = fdata[offset];
-        for(int i = offset + stride; i < _renderData._instanceCount * stride; i += stride)
-        {
-            if(fdata[i] < min) min = fdata[i];
-        }
-        return min;
-    }
-
     int internal_render_mode = 0;
     bool internal_render_mode_changed = false;
     unsigned int _instanceCountLast = 0;
+    PropertyGenericData* _meshIndicesLast = nullptr;
     RenderNodeData _renderData;
     bool _render_data_changed = false;
     bool _fog_changed_last_frame = false;
     bool _motif_changed_internal = false;
     bool _first_load = false;
+    bool _compact_positions_changed = false;
+    InstanceDirtyRanges _instanceDirtyRanges;
+    InstanceStreamSlot _streamSlot;
+    bool _instance_arrays_stale = false;
 };
@@ -0,0 +1,182 @@
+#pragma once
+#include "node.h"
+#include "../../math/vector.h"
+
+struct SliceNode final : public PropertyNode
+{
+    inline SliceNode() : PropertyNode(Type::SLICE, 4, { "list", "offset", "count", "stride" }, 2, { "list", "size" })
+    {
+        static int inc = 0;
+        name = "List Slice Node #" + std::to_string(inc++);
+
+        inputs_description["list"] = "The list to slice.";
+        inputs_description["offset"] = "The index of the first element.";
+        inputs_description["count"] = "The maximum number of elements to take (0 takes every element until the end of the list).";
+        inputs_description["stride"] = "The step between taken elements (1 takes every element).";
+
+        setOutputNominalTypes<
+            std::vector<float>,
+            std::vector<int>,
+            std::vector<unsigned int>,
+            std::vector<Vector2>,
+            std::vector<Vector3>,
+            std::vector<Vector4>
+        >("list", "The sliced list. References the input list elements without copying them.");
+
+        setOutputNominalTypes<unsigned int>("size", "The sliced list size.");
+    }
+
+    ~SliceNode() {  }
+
+    inline virtual void render() override
+    {
+        renderParameter("Offset", "offset", &offset, 0);
+        renderParameter("Count", "count", &count, 0);
+        renderParameter("Stride", "stride", &stride, 1);
+
+        ImGui::BeginDisabled();
+        ImGui::InputScalar("Size", ImGuiDataType_U32, &slice_size);
+        ImGui::EndDisabled();
+    }
+
+    inline virtual void update() override
+    {
+        resetOutputsDataUpdate();
+
+        disconnectInputIfNotOfType<
+            std::vector<float>,
+            std::vector<int>,
+            std::vector<unsigned int>,
+            std::vector<Vector2>,
+            std::vector<Vector3>,
+            std::vector<Vector4>
+        >("list");
+
+        disconnectInputIfNotOfType<unsigned int, int>("offset");
+        disconnectInputIfNotOfType<unsigned int, int>("count");
+        disconnectInputIfNotOfType<unsigned int, int>("stride");
+
+        readParameter("offset", &offset, 0);
+        readParameter("count", &count, 0);
+        readParameter("stride", &stride, 1);
+
+        auto list_it = inputs_named.find("list");
+        PropertyGenericData* list = (list_it != inputs_named.end()) ? list_it->second : nullptr;
+
+        if(list == nullptr)
+        {
+            if(last_list != nullptr) clearOutput();
+            last_list = nullptr;
+            return;
+        }
+
+        bool params_changed = (offset != last_offset) || (count != last_count) || (stride != last_stride);
+        if(list != last_list || params_changed || list->dataChanged())
+        {
+                 if(sliceIfOfType<float>       (list));
+            else if(sliceIfOfType<int>         (list));
+            else if(sliceIfOfType<unsigned int>(list));
+            else if(sliceIfOfType<Vector2>     (list));
+            else if(sliceIfOfType<Vector3>     (list));
+            else if(sliceIfOfType<Vector4>     (list)) {  }
+
+            slice_size = (unsigned int)outputs_named["list"]->getListSize();
+            setNamedOutput("size", slice_size);
+        }
+
+        last_list = list;
+        last_offset = offset;
+        last_count = count;
+        last_stride = stride;
+    }
+
+    inline virtual void onDisconnect(const std::string& inputName) override
+    {
+        // The view must not outlive its source
+        if(inputName == "list")
+        {
+            clearOutput();
+            last_list = nullptr;
+        }
+    }
+
+    inline virtual ByteBuffer serialize() const override
+    {
+        ByteBuffer buffer = PropertyNode::serialize();
+
+        buffer.add(offset);
+        buffer.add(count);
+        buffer.add(stride);
+
+        return buffer;
+    }
+
+    inline virtual void deserialize(ByteBuffer& buffer) override
+    {
+        PropertyNode::deserialize(buffer);
+
+        buffer.get(&offset);
+        buffer.get(&count);
+        buffer.get(&stride);
+    }
+
+private:
+    int offset = 0;
+    int count = 0;
+    int stride = 1;
+    unsigned int slice_size = 0;
+
+    int last_offset = 0;
+    int last_count = 0;
+    int last_stride = 1;
+    PropertyGenericData* last_list = nullptr;
+
+    inline void renderParameter(const char* label, const std::string& input, int* value, int min)
+    {
+        bool connected = inputs_named.find(input) != inputs_named.end();
+        ImGui::BeginDisabled(connected);
+        if(ImGui::InputInt(label, value))
+        {
+            if(*value < min) *value = min;
+        }
+        ImGui::EndDisabled();
+    }
+
+    inline void readParameter(const std::string& input, int* value, int min)
+    {
+        auto it = inputs_named.find(input);
+        if(it != inputs_named.end())
+        {
+            if(it->second->isOfType<unsigned int>())
+            {
+                *value = (int)it->second->getValue<unsigned int>();
+            }
+            else if(it->second->isOfType<int>())
+            {
+                *value = it->second->getValue<int>();
+            }
+        }
+        if(*value < min) *value = min;
+    }
+
+    inline void clearOutput()
+    {
+        setNamedOutput("list", EmptyType());
+        slice_size = 0;
+        setNamedOutput("size", 0U);
+    }
+
+    template<typename T>
+    inline bool sliceIfOfType(PropertyGenericData* list)
+    {
+        if(!list->isOfType<std::vector<T>>()) return false;
+
+        PropertyGenericData::ListSegment segment;
+        segment.source = list;
+        segment.offset = (size_t)offset;
+        segment.count = (count > 0) ? (size_t)count : SIZE_MAX;
+        segment.stride = (size_t)stride;
+        outputs_named["list"]->setListView<T>({ segment });
+        return true;
+    }
+};
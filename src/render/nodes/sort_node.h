@@ -0,0 +1,252 @@
+#pragma once
+#include "node.h"
+#include "../../math/vector.h"
+#include "../../math/reduce.inl"
+#include "../../math/sort.inl"
+#include <cmath>
+
+struct SortNode final : public PropertyNode
+{
+    enum class Mode
+    {
+        ASCENDING,
+        DESCENDING,
+        MORTON_30,
+        MORTON_63
+    } mode;
+
+    inline SortNode() : PropertyNode(Type::SORT, 1, { "list" }, 2, { "list", "permutation" })
+    {
+        static int inc = 0;
+        name = "Sort Node #" + std::to_string(inc++);
+        mode = Mode::ASCENDING;
+
+        inputs_description["list"] = "The list to sort. Vector lists are sorted by the selected component, or by Morton code (Vector3 only).";
+
+        setOutputNominalTypes<
+            std::vector<float>,
+            std::vector<int>,
+            std::vector<unsigned int>,
+            std::vector<Vector2>,
+            std::vector<Vector3>,
+            std::vector<Vector4>
+        >("list", "The sorted list.");
+
+        setOutputNominalTypes<std::vector<unsigned int>>(
+            "permutation",
+            "The source index of each sorted element. Use it with a batched List Access Node to reorder other lists the same way."
+        );
+    }
+
+    ~SortNode() {  }
+
+    inline virtual void render() override
+    {
+        static const char* const mode_names[] = {
+            "Ascending",
+            "Descending",
+            "Morton (30 bit)",
+            "Morton (63 bit)"
+        };
+
+        static const char* const component_names[] = {
+            "X",
+            "Y",
+            "Z",
+            "W"
+        };
+
+        ImGui::Combo("Mode", &currentmodeid, mode_names, sizeof(mode_names) / sizeof(mode_names[0]));
+        mode = static_cast<Mode>(currentmodeid);
+
+        if(mode == Mode::ASCENDING || mode == Mode::DESCENDING)
+        {
+            ImGui::Combo("Key", &component, component_names, sizeof(component_names) / sizeof(component_names[0]));
+        }
+
+        ImGui::BeginDisabled();
+        ImGui::InputScalar("Size", ImGuiDataType_U32, &list_size);
+        ImGui::EndDisabled();
+    }
+
+    inline virtual void update() override
+    {
+        resetOutputsDataUpdate();
+
+        disconnectInputIfNotOfType<
+            std::vector<float>,
+            std::vector<int>,
+            std::vector<unsigned int>,
+            std::vector<Vector2>,
+            std::vector<Vector3>,
+            std::vector<Vector4>
+        >("list");
+
+        auto list_it = inputs_named.find("list");
+        PropertyGenericData* list = (list_it != inputs_named.end()) ? list_it->second : nullptr;
+
+        bool changed = (list != last_list) || (mode != last_mode) || (component != last_component) || (list && list->dataChanged());
+        last_list = list;
+        last_mode = mode;
+        last_component = component;
+
+        if(!changed || list == nullptr) return;
+
+             if(sortIfOfType<float>       (list));
+        else if(sortIfOfType<int>         (list));
+        else if(sortIfOfType<unsigned int>(list));
+        else if(sortIfOfType<Vector2>     (list));
+        else if(sortIfOfType<Vector3>     (list));
+        else if(sortIfOfType<Vector4>     (list)) {  }
+    }
+
+    inline virtual ByteBuffer serialize() const override
+    {
+        ByteBuffer buffer = PropertyNode::serialize();
+
+        buffer.add(currentmodeid);
+        buffer.add(component);
+
+        return buffer;
+    }
+
+    inline virtual void deserialize(ByteBuffer& buffer) override
+    {
+        PropertyNode::deserialize(buffer);
+
+        buffer.get(&currentmodeid);
+        buffer.get(&component);
+        mode = static_cast<Mode>(currentmodeid);
+    }
+
+private:
+    static constexpr size_t SORT_MIN_ELEMENTS_PER_THREAD = 1 << 15;
+
+    int currentmodeid = 0;
+    int component = 0;
+    unsigned int list_size = 0;
+    PropertyGenericData* last_list = nullptr;
+    Mode last_mode = Mode::ASCENDING;
+    int last_component = 0;
+
+    std::vector<uint32_t> keys32;
+    std::vector<uint64_t> keys64;
+
+    template<typename S>
+    static inline uint32_t scalarKey(S v)
+    {
+        if constexpr(std::is_same_v<S, float>) return Math::FloatToRadixKey(v);
+        else if constexpr(std::is_same_v<S, int>) return Math::IntToRadixKey(v);
+        else return (uint32_t)v;
+    }
+
+    template<typename E>
+    inline bool sortIfOfType(PropertyGenericData* list)
+    {
+        using S = typename Math::ListElementTraits<E>::Scalar;
+        constexpr size_t N = Math::ListElementTraits<E>::Components;
+
+        if(!list->isOfType<std::vector<E>>()) return false;
+
+        const std::vector<E>& src = list->getValue<std::vector<E>>();
+        const size_t count = src.size();
+        list_size = (unsigned int)count;
+
+        std::vector<unsigned int> perm;
+        if(mode == Mode::MORTON_30 || mode == Mode::MORTON_63)
+        {
+            if constexpr(std::is_same_v<E, Vector3>)
+            {
+                perm = (mode == Mode::MORTON_30) ? mortonPermutation<uint32_t>(src, keys32, 10) : mortonPermutation<uint64_t>(src, keys64, 21);
+            }
+            else
+            {
+                // Nothing downstream may keep the last sorted list
+                L_WARNING("Sort Node: Morton ordering requires a Vector3 list.");
+                outputs_named["list"]->resizeList<E>(0);
+                outputs_named["permutation"]->resizeList<unsigned int>(0);
+                return true;
+            }
+        }
+        else
+        {
+            const size_t c = std::min((size_t)component, N - 1);
+            const bool descending = (mode == Mode::DESCENDING);
+            const S* scalars = (const S*)src.data();
+
+            keys32.resize(count);
+            uint32_t* keys = keys32.data();
+            Utils::ParallelFor(count, SORT_MIN_ELEMENTS_PER_THREAD, [=](size_t begin, size_t end) {
+                for(size_t i = begin; i < end; i++)
+                {
+                    uint32_t k = scalarKey(scalars[i * N + c]);
+                    keys[i] = descending ? ~k : k;
+                }
+            });
+            perm = Math::ParallelRadixSortPermutation(keys32, 32);
+        }
+
+        auto& out = outputs_named["list"]->resizeList<E>(count);
+        E* dst = out.data();
+        const E* in = src.data();
+        const unsigned int* p = perm.data();
+        Utils::ParallelFor(count, SORT_MIN_ELEMENTS_PER_THREAD, [=](size_t begin, size_t end) {
+            for(size_t i = begin; i < end; i++) dst[i] = in[p[i]];
+        });
+
+        setNamedOutput("permutation", perm);
+        return true;
+    }
+
+    // Quantizes the positions inside their bounds to axisBits per axis and sorts by the interleaved code
+    template<typename K>
+    inline std::vector<unsigned int> mortonPermutation(const std::vector<Vector3>& positions, std::vector<K>& keys, unsigned int axisBits)
+    {
+        const size_t count = positions.size();
+        Vector3 lo, hi;
+        Math::ParallelMinMax((const float*)positions.data(), 3, count, lo.data, hi.data);
+
+        // Non finite positions would poison the bounds, those axes are bounded by their finite values only
+        for(int c = 0; c < 3; c++)
+        {
+            if(std::isfinite(lo.data[c]) && std::isfinite(hi.data[c])) continue;
+
+            lo.data[c] = INFINITY;
+            hi.data[c] = -INFINITY;
+            for(const Vector3& p : positions)
+            {
+                if(!std::isfinite(p.data[c])) continue;
+                lo.data[c] = std::min(lo.data[c], p.data[c]);
+                hi.data[c] = std::max(hi.data[c], p.data[c]);
+            }
+        }
+
+        const float cells = (float)((1u << axisBits) - 1);
+        Vector3 scale;
+        for(int c = 0; c < 3; c++)
+        {
+            float extent = hi.data[c] - lo.data[c];
+            scale.data[c] = extent > 0.0f ? cells / extent : 0.0f;
+        }
+
+        keys.resize(count);
+        K* k = keys.data();
+        const Vector3* pos = positions.data();
+        Utils::ParallelFor(count, SORT_MIN_ELEMENTS_PER_THREAD, [=](size_t begin, size_t end) {
+            for(size_t i = begin; i < end; i++)
+            {
+                K q[3];
+                for(int c = 0; c < 3; c++)
+                {
+                    // Casting a non finite value is undefined, those go to the first cell
+                    float v = (pos[i].data[c] - lo.data[c]) * scale.data[c];
+                    q[c] = std::isfinite(v) ? (K)std::min(std::max(v, 0.0f), cells) : 0;
+                }
+                if constexpr(sizeof(K) == 4) k[i] = Math::MortonEncode30(q[0], q[1], q[2]);
+                else                         k[i] = Math::MortonEncode63(q[0], q[1], q[2]);
+            }
+        });
+
+        return Math::ParallelRadixSortPermutation(keys, axisBits * 3);
+    }
+};
@@ -1,6 +1,7 @@
 #include "raster_renderer.h"
 #include <fstream>
 #include <string>
+#include <numeric>
 #include <cstdlib>
 #include <ctime>
 #include "../log/logger.h"
@@ -8,6 +9,9 @@
 #include "nodes/render_node.h"
 #include "../../imgui/backends/imgui_impl_glfw.h"
 #include "renderer.h"
+#include "../math/frustum.inl"
+#include "../math/sort.inl"
+#include "../math/vertex_pack.inl"
 
 #include <GLFW/glfw3.h>
 
@@ -148,67 +152,82 @@ RasterRenderer::DrawInstance::DrawInstance()
     glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
     glEnableVertexAttribArray(3);
 
+    // The default cube is not indexed
+    glGenBuffers(1, &_ebo);
+    _indexType = 0;
     _idxcount = 36;
+    _sharedMesh = nullptr;
+    _meshCompact = false;
+    _meshOrigin = Vector3(0.0f, 0.0f, 0.0f);
+    _meshExtent = Vector3(1.0f, 1.0f, 1.0f);
+    _node = nullptr;
+    _streamSlot = nullptr;
+    _streamRequested = false;
+    _streamed = false;
+    _meshSource = nullptr;
+    _meshStale = false;
+    _meshCount = 1;
+    _meshParam = 0.0f;
+    _positionOrigin = Vector3(0.0f, 0.0f, 0.0f);
+    _positionExtent = Vector3(1.0f, 1.0f, 1.0f);
+    _motifSize = Vector3(0.0f, 0.0f, 0.0f);
+    _motifTiles[0] = _motifTiles[1] = _motifTiles[2] = 0;
+
     _instanceCount = 1;
+    _drawCount = 1;
+    _compacted = false;
+    _compactMode = 0;
+    _palette = false;
+    _lodLevels = 1;
+    _lodEye = Vector3(0.0f, 0.0f, 0.0f);
+    _lodScale = 0.0f;
+    _meshOptions = 0;
+    glGenBuffers(1, &_indirect);
     _motif_span = 1;
+    // Instance positions (vec3 floats or 16 bit quantized, see bindInstanceAttributes)
     glGenBuffers(1, &_ipb);
     glBindBuffer(GL_ARRAY_BUFFER, _ipb);
     _intancePositionMatrixPtr = nullptr;
-    glBufferData(GL_ARRAY_BUFFER, _instanceCount * sizeof(Vector4), nullptr, GL_DYNAMIC_DRAW);
+    _ipbCapacity = _instanceCount * sizeof(Vector3);
+    glBufferData(GL_ARRAY_BUFFER, _ipbCapacity, nullptr, GL_DYNAMIC_DRAW);
 
-    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(Vector4), (void*)0);
+    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vector3), (void*)0);
     glEnableVertexAttribArray(4);
     glVertexAttribDivisor(4, 1);
 
+    // Instance colors (RGBA8)
     glGenBuffers(1, &_icb);
     glBindBuffer(GL_ARRAY_BUFFER, _icb);
     _instanceColorsPtr = nullptr;
-    glBufferData(GL_ARRAY_BUFFER, _instanceCount * sizeof(Vector4), nullptr, GL_DYNAMIC_DRAW);
+    _icbCapacity = _instanceCount * sizeof(InstanceColor8);
+    glBufferData(GL_ARRAY_BUFFER, _icbCapacity, nullptr, GL_DYNAMIC_DRAW);
 
-    glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(Vector4), (void*)0);
+    glVertexAttribPointer(5, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(InstanceColor8), (void*)0);
     glEnableVertexAttribArray(5);
     glVertexAttribDivisor(5, 1);
 
+    // Instance rotations (euler angles, the vertex shader builds the matrix)
     glGenBuffers(1, &_irb);
     glBindBuffer(GL_ARRAY_BUFFER, _irb);
     _intanceRotationMatrixPtr = nullptr;
-    glBufferData(GL_ARRAY_BUFFER, _instanceCount * sizeof(glm::mat4), nullptr, GL_DYNAMIC_DRAW);
+    _irbCapacity = _instanceCount * sizeof(Vector3);
+    glBufferData(GL_ARRAY_BUFFER, _irbCapacity, nullptr, GL_DYNAMIC_DRAW);
 
-    glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(glm::vec4), (void*)0);
+    glVertexAttribPointer(6, 3, GL_FLOAT, GL_FALSE, sizeof(Vector3), (void*)0);
     glEnableVertexAttribArray(6);
-    glVertexAttribPointer(7, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(glm::vec4), (void*)(1 * sizeof(glm::vec4)));
-    glEnableVertexAttribArray(7);
-    glVertexAttribPointer(8, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(glm::vec4), (void*)(2 * sizeof(glm::vec4)));
-    glEnableVertexAttribArray(8);
-    glVertexAttribPointer(9, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(glm::vec4), (void*)(3 * sizeof(glm::vec4)));
-    glEnableVertexAttribArray(9);
-
     glVertexAttribDivisor(6, 1);
-    glVertexAttribDivisor(7, 1);
-    glVertexAttribDivisor(8, 1);
-    glVertexAttribDivisor(9, 1);
-
-    glGenBuffers(1, &_mpb);
-    glBindBuffer(GL_ARRAY_BUFFER, _mpb);
-    _motifPositionMatrixPtr = nullptr;
-    glBufferData(GL_ARRAY_BUFFER, _motif_span * _instanceCount * sizeof(glm::mat4), nullptr, GL_DYNAMIC_DRAW);
-
-    glVertexAttribPointer(10, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(glm::vec4), (void*)0);
-    glVertexAttribPointer(11, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(glm::vec4), (void*)(1 * sizeof(glm::vec4)));
-    glVertexAttribPointer(12, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(glm::vec4), (void*)(2 * sizeof(glm::vec4)));
-    glVertexAttribPointer(13, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(glm::vec4), (void*)(3 * sizeof(glm::vec4)));
-    glEnableVertexAttribArray(10);
-    glEnableVertexAttribArray(11);
-    glEnableVertexAttribArray(12);
-    glEnableVertexAttribArray(13);
-    glVertexAttribDivisor(10, 1);
-    glVertexAttribDivisor(11, 1);
-    glVertexAttribDivisor(12, 1);
-    glVertexAttribDivisor(13, 1);
 
     glBindVertexArray(0);
+
+    // Only the center tile is visible without motif repetition
+    _visibleTiles = { 0 };
+    _meshRadius = std::sqrt(3.0f) * 0.5f;
+    glGenBuffers(1, &_vtb);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _vtb);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(unsigned int), _visibleTiles.data(), GL_DYNAMIC_DRAW);
 }
 
+// Every instance is drawn _motif_span times (once per motif tile)
 void RasterRenderer::DrawInstance::updateMotifInstanceForVertexArray()
 {
     glBindVertexArray(_vao);
@@ -221,29 +240,195 @@ void RasterRenderer::DrawInstance::updateMotifInstanceForVertexArray()
 
     // rotation
     glVertexAttribDivisor(6, _motif_span);
-    glVertexAttribDivisor(7, _motif_span);
-    glVertexAttribDivisor(8, _motif_span);
-    glVertexAttribDivisor(9, _motif_span);
+}
+
+// Points the mesh attributes of every merged mesh at float or compact (Math::MeshVertex16) vertices
+// Also attaches the element buffer of the drawn mesh buffers
+void RasterRenderer::DrawInstance::bindMeshAttributes(bool compact)
+{
+    glBindVertexArray(_vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer());
+
+    for(unsigned int i = 0; i < MAX_MESH_MERGE; i++)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, meshBuffer(i));
+        if(compact)
+        {
+            glVertexAttribPointer(i,     4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(Math::MeshVertex16), (void*)offsetof(Math::MeshVertex16, x));
+            glVertexAttribPointer(2 + i, 2, GL_SHORT,          GL_TRUE, sizeof(Math::MeshVertex16), (void*)offsetof(Math::MeshVertex16, nx));
+        }
+        else
+        {
+            glVertexAttribPointer(i,     3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+            glVertexAttribPointer(2 + i, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+        }
+    }
 
-    // motif
-    glVertexAttribDivisor(10, 1);
-    glVertexAttribDivisor(11, 1);
-    glVertexAttribDivisor(12, 1);
-    glVertexAttribDivisor(13, 1);
+    glBindVertexArray(0);
+    _meshCompact = compact;
+}
+
+void RasterRenderer::DrawInstance::bindInstanceAttributes(GLuint positions, GLintptr positionsOffset, bool compact, GLuint rotations, GLintptr rotationsOffset, GLuint colors, GLintptr colorsOffset)
+{
+    glBindVertexArray(_vao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, positions);
+    if(compact)
+    {
+        glVertexAttribPointer(4, 4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(InstancePosition16), (void*)positionsOffset);
+    }
+    else
+    {
+        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vector3), (void*)positionsOffset);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, rotations);
+    glVertexAttribPointer(6, 3, GL_FLOAT, GL_FALSE, sizeof(Vector3), (void*)rotationsOffset);
+
+    glBindBuffer(GL_ARRAY_BUFFER, colors);
+    glVertexAttribPointer(5, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(InstanceColor8), (void*)colorsOffset);
+}
+
+void RasterRenderer::DrawInstance::createStreamRing(unsigned int capacity)
+{
+    destroyStreamRing();
+
+    constexpr GLsizeiptr SLOT_ALIGNMENT = 256;
+    const GLsizeiptr slotSize = capacity * (2 * sizeof(Vector3) + sizeof(InstanceColor8));
+    _stream.slotSize = (slotSize + SLOT_ALIGNMENT - 1) / SLOT_ALIGNMENT * SLOT_ALIGNMENT;
+    _stream.capacity = capacity;
+    _stream.slot = 0;
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &_stream.buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, _stream.buffer);
+    glBufferStorage(GL_ARRAY_BUFFER, STREAM_RING_SIZE * _stream.slotSize, nullptr, flags);
+    _stream.mapped = (unsigned char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, STREAM_RING_SIZE * _stream.slotSize, flags);
+
+    if(_stream.mapped == nullptr)
+    {
+        L_ERROR("Failed to map the instance streaming buffer.");
+        destroyStreamRing();
+        return;
+    }
+
+    L_DEBUG("Instance streaming ring: %u instances per slot (%d kb)", capacity, (int)(STREAM_RING_SIZE * _stream.slotSize / 1024));
+}
+
+void RasterRenderer::DrawInstance::destroyStreamRing()
+{
+    for(GLsync& fence : _stream.fences)
+    {
+        if(fence != nullptr)
+        {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+
+    if(_stream.buffer != 0)
+    {
+        // Deleting the buffer unmaps it, draws in flight keep their storage alive
+        glDeleteBuffers(1, &_stream.buffer);
+    }
+
+    _stream.buffer = 0;
+    _stream.mapped = nullptr;
+    _stream.capacity = 0;
+}
+
+void RasterRenderer::DrawInstance::bindStreamSlot()
+{
+    const GLintptr base = _stream.slot * _stream.slotSize;
+    bindInstanceAttributes(
+        _stream.buffer, base, false,
+        _stream.buffer, base + _stream.capacity * sizeof(Vector3),
+        _stream.buffer, base + _stream.capacity * 2 * sizeof(Vector3)
+    );
+}
+
+void RasterRenderer::DrawInstance::fenceStreamSlot()
+{
+    GLsync& fence = _stream.fences[_stream.slot];
+    if(fence != nullptr) glDeleteSync(fence);
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+// Moves to the next slot, waits until the GPU is done reading from it and hands it to the render node
+void RasterRenderer::DrawInstance::publishStreamSlot(InstanceStreamSlot* slot)
+{
+    _stream.slot = (_stream.slot + 1) % STREAM_RING_SIZE;
+
+    GLsync& fence = _stream.fences[_stream.slot];
+    if(fence != nullptr)
+    {
+        GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        while(result == GL_TIMEOUT_EXPIRED)
+        {
+            result = glClientWaitSync(fence, 0, 1000000000);
+        }
+
+        if(result == GL_WAIT_FAILED)
+        {
+            L_ERROR("Instance streaming fence wait failed.");
+        }
+
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    unsigned char* base = _stream.mapped + _stream.slot * _stream.slotSize;
+    slot->positions = (Vector3*)base;
+    slot->rotations = (Vector3*)(base + _stream.capacity * sizeof(Vector3));
+    slot->colors = (InstanceColor8*)(base + _stream.capacity * 2 * sizeof(Vector3));
+    slot->capacity = _stream.capacity;
 }
 
 RasterRenderer::DrawInstance::~DrawInstance()
 {
     glDeleteVertexArrays(1, &_vao);
     glDeleteBuffers(MAX_MESH_MERGE, _vbo);
+    glDeleteBuffers(1, &_ebo);
     glDeleteBuffers(1, &_ipb);
     glDeleteBuffers(1, &_icb);
     glDeleteBuffers(1, &_irb);
-    glDeleteBuffers(1, &_mpb);
+    glDeleteBuffers(1, &_vtb);
+    glDeleteBuffers(1, &_indirect);
+    destroyStreamRing();
 
     L_TRACE("~DrawInstance()");
 }
 
+// Below this many instances per thread gathers run single threaded
+constexpr size_t GATHER_MIN_INSTANCES_PER_THREAD = 1 << 15;
+
+// Uploads the modified instance range of an attribute buffer
+// The storage is only reallocated when it needs to grow, in which case every instance is uploaded
+static void UploadInstanceRange(GLuint buffer, GLsizeiptr* capacity, const void* data, size_t elementSize, unsigned int count, InstanceDirtyRange* dirty)
+{
+    const GLsizeiptr size = (GLsizeiptr)(count * elementSize);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+    if(size > *capacity)
+    {
+        *capacity = std::max(size, *capacity + *capacity / 2);
+        glBufferData(GL_ARRAY_BUFFER, *capacity, nullptr, GL_DYNAMIC_DRAW);
+        dirty->add(0, count);
+    }
+
+    const unsigned int end = std::min(dirty->end, count);
+    if(!dirty->empty() && dirty->begin < end)
+    {
+        glBufferSubData(
+            GL_ARRAY_BUFFER,
+            (GLintptr)(dirty->begin * elementSize),
+            (GLsizeiptr)((end - dirty->begin) * elementSize),
+            (const unsigned char*)data + dirty->begin * elementSize
+        );
+    }
+    dirty->clear();
+}
+
 static void GeneratePerlin2DTex(GLsizei w, GLsizei h, unsigned char* buffer)
 {
     auto idx = [w](int x, int y) -> int { return 3 * (x + y * w); };
@@ -281,13 +466,22 @@ RasterRenderer::DrawList::DrawList(GLFWwindow* window, Renderer::ScreenRenderDat
     int sw = (int)screenRenderData->screen_size[0];
     int sh = (int)screenRenderData->screen_size[1];
     
-    addInstance(new DrawInstance());
+    _defaultInstance = new DrawInstance();
 
     this->camera = camera;
 
     glUseProgram(_program_nrmpass);
     _uniforms.projectionMatrix = glGetUniformLocation(_program_nrmpass, "projectionMatrix");
     _uniforms.viewMatrix = glGetUniformLocation(_program_nrmpass, "viewMatrix");
+    _uniforms.instanceOrigin = glGetUniformLocation(_program_nrmpass, "instanceOrigin");
+    _uniforms.instanceExtent = glGetUniformLocation(_program_nrmpass, "instanceExtent");
+    _uniforms.motifSize = glGetUniformLocation(_program_nrmpass, "motifSize");
+    _uniforms.motifTiles = glGetUniformLocation(_program_nrmpass, "motifTiles");
+    _uniforms.motifSpan = glGetUniformLocation(_program_nrmpass, "motifSpan");
+    _uniforms.meshCount = glGetUniformLocation(_program_nrmpass, "meshCount");
+    _uniforms.meshOrigin = glGetUniformLocation(_program_nrmpass, "meshOrigin");
+    _uniforms.meshExtent = glGetUniformLocation(_program_nrmpass, "meshExtent");
+    _uniforms.meshCompact = glGetUniformLocation(_program_nrmpass, "meshCompact");
     
     glUniformMatrix4fv(_uniforms.projectionMatrix, 1, GL_FALSE, &camera->projectionMatrix[0][0]);
 
@@ -439,10 +633,14 @@ RasterRenderer::DrawList::~DrawList()
 {
     for(auto i : instances)
     {
+        releaseMeshBuffers(i);
+        prefetchMeshBuffers(i, nullptr, false);
         delete i;
     }
 
     instances.clear();
+    delete _defaultInstance;
+
     glDeleteProgram(_program_nrmpass);
     glDeleteProgram(_program_sobfilter);
     glDeleteProgram(_program_fogpart);
@@ -490,136 +688,983 @@ void RasterRenderer::DrawList::updateCameraPerspective()
 
 void RasterRenderer::DrawList::render(GLFWwindow* window, NodeWindow* nodeWindow, AnalyticsWindow* analyticsWindow, OptionsWindow* optionsWindow)
 {
-    // TODO: Pass this node as a param (no need to re-check for null and getValue all over again)
-    RenderNode* outNode = dynamic_cast<RenderNode*>(nodeWindow->getRenderOutputNode());
+    syncInstances(nodeWindow);
 
-    if(outNode != nullptr)
+    // Scene wide settings (fog, camera motif wrapping) come from the first render node
+    RenderNode* sceneNode = dynamic_cast<RenderNode*>(nodeWindow->getRenderOutputNode());
+    if(sceneNode != nullptr && sceneNode->outputs[0]->dataChanged())
     {
-        RenderNodeData nodeData = outNode->outputs[0]->getValue<RenderNodeData>();
+        RenderNodeData nodeData = sceneNode->outputs[0]->getValue<RenderNodeData>();
 
-        if(nodeWindow->isRenderOutputNodeChanged())
+        if(nodeData._fogChanged)
         {
-            // RenderNodeData nodeData = outNode->data.getValue<RenderNodeData>();
-            instances[0]->_instanceCount = nodeData._instanceCount;
-            instances[0]->_intancePositionMatrixPtr = nodeData._worldPositionPtr;
-            instances[0]->_intanceRotationMatrixPtr = nodeData._worldRotationPtr;
-            instances[0]->_instanceColorsPtr = nodeData._instanceColorsPtr;
+            // NOTE: Using glGetUniformLocation should be ok: this won't change that often and I'm lazy
+            glUseProgram(_program_sobfilter);
+            glUniform1f(glGetUniformLocation(_program_sobfilter, "fogMax"), nodeData._fogMax);
+            glUniform1f(glGetUniformLocation(_program_sobfilter, "fogMin"), nodeData._fogMin);
+            // fogcolor is background basically (no volumetric fog)
+            glClearColor(nodeData._fogColor.x, nodeData._fogColor.y, nodeData._fogColor.z, 1.0f);
         }
 
-        if(outNode->renderDataChanged())
+        glUseProgram(_program_sobfilter);
+        glUniform1f(glGetUniformLocation(_program_sobfilter, "fogMax"), nodeData._fogMax);
+        glUniform1ui(glGetUniformLocation(_program_sobfilter, "meshCount"), nodeData._meshCount);
+        glUniform1f(_uniforms.all_meshParam, nodeData._meshParam);
+
+        if(nodeData._repeatBlocks && nodeData._motifChanged)
         {
-            instances[0]->_instanceCount = nodeData._instanceCount;
+            Renderer::SetGlobalSceneMotif(nodeData._motifSize);
+            // FIXME : Fog Updater SLOOOOW
+            // updateFogParticlesMotifSize();
+        }
+        else if(!nodeData._repeatBlocks)
+        {
+            Renderer::SetGlobalSceneMotif(infinityVec3);
+
+            // FIXME : Take care of this please
+            // updateFogParticlesMotifSize();
+        }
+    }
+
+    for(DrawInstance* instance : instances)
+    {
+        prepareInstance(instance);
+    }
+
+    // Without render nodes the default instance is drawn
+    _drawOrder.assign(instances.begin(), instances.end());
+    if(_drawOrder.empty())
+    {
+        _drawOrder.push_back(_defaultInstance);
+    }
 
-            MeshNodeData* mesh = *(nodeData._meshPtr);
-            if(mesh != nullptr)
+    // Instances sharing the same mesh state are drawn next to each other, so fewer uniforms change between draws
+    std::sort(_drawOrder.begin(), _drawOrder.end(), [](const DrawInstance* a, const DrawInstance* b) {
+        if(a->_meshSource != b->_meshSource) return a->_meshSource < b->_meshSource;
+        if(a->_meshCount != b->_meshCount) return a->_meshCount < b->_meshCount;
+        return a->_meshParam < b->_meshParam;
+    });
+
+    // Render using normals to create an image to the sobel filter for edge detection
+    glUseProgram(_program_nrmpass);
+    glUniformMatrix4fv(_uniforms.viewMatrix, 1, GL_FALSE, &camera->viewMatrix[0][0]);
+    glBindFramebuffer(GL_FRAMEBUFFER, _rendertarget.framebuffer_id);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    const DrawInstance* last = nullptr;
+    for(DrawInstance* instance : _drawOrder)
+    {
+        drawInstance(instance, last);
+        last = instance;
+    }
+
+    // Hand the next ring slots over to the render nodes (they update after this)
+    for(DrawInstance* instance : instances)
+    {
+        handOverStreamSlot(instance);
+    }
+
+    drawPostProcess();
+}
+
+// Keeps one draw instance per render node, new instances start from the node's current data
+void RasterRenderer::DrawList::syncInstances(NodeWindow* nodeWindow)
+{
+    const std::vector<PropertyNode*>& nodes = nodeWindow->getRenderNodes();
+
+    for(auto it = instances.begin(); it != instances.end();)
+    {
+        if(std::find(nodes.begin(), nodes.end(), (*it)->_node) == nodes.end())
+        {
+            releaseMeshBuffers(*it);
+            prefetchMeshBuffers(*it, nullptr, false);
+            delete *it;
+            it = instances.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    for(PropertyNode* node : nodes)
+    {
+        auto found = std::find_if(instances.begin(), instances.end(), [node](const DrawInstance* i) { return i->_node == node; });
+        if(found != instances.end()) continue;
+
+        RenderNodeData nodeData = node->outputs[0]->getValue<RenderNodeData>();
+
+        DrawInstance* instance = new DrawInstance();
+        instance->_node = node;
+        instance->_instanceCount = nodeData._instanceCount;
+        instance->_intancePositionMatrixPtr = nodeData._worldPositionPtr;
+        instance->_intanceRotationMatrixPtr = nodeData._worldRotationPtr;
+        instance->_instanceColorsPtr = nodeData._instanceColorsPtr;
+        instance->_meshStale = true;
+
+        // The buffers are empty
+        if(nodeData._instanceDirty != nullptr)
+        {
+            nodeData._instanceDirty->all(nodeData._instanceCount);
+        }
+
+        addInstance(instance);
+    }
+}
+
+// Sets the vertex format of the instance meshes, compact vertices are quantized inside the bounds of every mesh
+// Also updates the mesh bounding radius around the instance origin, for any rotation
+static void SetMeshVertexFormat(RasterRenderer::DrawInstance* instance, const MeshNodeData* meshes, unsigned int count, bool compact)
+{
+    Vector3 min = infinityVec3;
+    Vector3 max = Vector3(0.0f, 0.0f, 0.0f) - infinityVec3;
+    float radius2 = 0.0f;
+    for(unsigned int i = 0; i < count; i++)
+    {
+        for(size_t v = 0; v + 2 < meshes[i].data_size; v += 6)
+        {
+            const float* p = meshes[i].vertex_data + v;
+            for(int c = 0; c < 3; c++)
             {
-                // Assuming all the meshes have the same attrs size at this point
-                size_t totalSize = mesh[0].data_size * sizeof(float);
-                instances[0]->_idxcount = (GLsizei)mesh[0].data_size / 6;
+                min.data[c] = std::min(min.data[c], p[c]);
+                max.data[c] = std::max(max.data[c], p[c]);
+            }
+            radius2 = std::max(radius2, p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+        }
+    }
+    instance->_meshRadius = std::sqrt(radius2);
+
+    if(compact && min.x <= max.x)
+    {
+        instance->_meshOrigin = min;
+        instance->_meshExtent = max - min;
+    }
+    else
+    {
+        compact = false;
+        instance->_meshOrigin = Vector3(0.0f, 0.0f, 0.0f);
+        instance->_meshExtent = Vector3(1.0f, 1.0f, 1.0f);
+    }
 
-                assert(nodeData._meshCount <= MAX_MESH_MERGE);
+    if(compact != instance->_meshCompact)
+    {
+        instance->bindMeshAttributes(compact);
+    }
+}
 
-                for(unsigned int i = 0; i < nodeData._meshCount; i++)
-                {
-                    glBindBuffer(GL_ARRAY_BUFFER, instances[0]->_vbo[i]);
-                    glBufferData(GL_ARRAY_BUFFER, totalSize, mesh[i].vertex_data, GL_STATIC_DRAW);
-                }
+// Bytes per vertex as uploaded
+static size_t MeshVertexSize(bool compact)
+{
+    return compact ? sizeof(Math::MeshVertex16) : 6 * sizeof(float);
+}
+
+// Writes the mesh vertices into the bound array buffer starting at vertex first (converted to the instance vertex format)
+static void UploadMeshVertices(const RasterRenderer::DrawInstance* instance, const MeshNodeData& mesh, size_t first, std::vector<uint8_t>& scratch)
+{
+    const size_t count = mesh.data_size / 6;
+    if(count == 0) return;
+
+    const size_t stride = MeshVertexSize(instance->_meshCompact);
+    const void* data = mesh.vertex_data;
+    if(instance->_meshCompact)
+    {
+        float scale[3];
+        for(int c = 0; c < 3; c++)
+        {
+            scale[c] = instance->_meshExtent.data[c] > 0.0f ? 65535.0f / instance->_meshExtent.data[c] : 0.0f;
+        }
+
+        scratch.resize(count * sizeof(Math::MeshVertex16));
+        Math::PackMeshVertices16(mesh.vertex_data, count, instance->_meshOrigin.data, scale, (Math::MeshVertex16*)scratch.data());
+        data = scratch.data();
+    }
+
+    glBufferSubData(GL_ARRAY_BUFFER, first * stride, count * stride, data);
+}
+
+// Levels of detail are drawn when any mesh has them (interpolated meshes blend whole vertex sets, so never)
+static bool MeshLodsAvailable(const RenderNodeData& nodeData)
+{
+    const MeshNodeData* mesh = *(nodeData._meshPtr);
+    if(!nodeData._meshLod || mesh == nullptr) return false;
+    if(!nodeData._meshPalette && nodeData._meshCount != 1) return false;
+
+    for(unsigned int i = 0; i < nodeData._meshCount; i++)
+    {
+        if(mesh[i].indexed() && mesh[i].lod_count > 0) return true;
+    }
+    return false;
+}
+
+// Uploads whatever the instance's render node changed and culls it for this frame
+void RasterRenderer::DrawList::prepareInstance(DrawInstance* instance)
+{
+    RenderNode* node = static_cast<RenderNode*>(instance->_node);
+    RenderNodeData nodeData = node->outputs[0]->getValue<RenderNodeData>();
+
+    instance->_streamSlot = nodeData._streamSlot;
+    instance->_streamRequested = nodeData._streamInstances && !nodeData._meshPalette;
+
+    const bool lod = MeshLodsAvailable(nodeData);
+    const int meshOptions = (nodeData._compactVertices ? 1 : 0) | (lod ? 2 : 0);
+    const bool meshOptionsChanged = *(nodeData._meshPtr) != nullptr && meshOptions != instance->_meshOptions;
+    if(node->renderDataChanged() || instance->_meshStale || meshOptionsChanged)
+    {
+        instance->_instanceCount = nodeData._instanceCount;
+
+        MeshNodeData* mesh = *(nodeData._meshPtr);
+        if(mesh != nullptr && (nodeData._meshPalette || lod))
+        {
+            // A single mesh with levels of detail is drawn as a palette of one
+            instance->_meshStale = false;
+            instance->_meshOptions = meshOptions;
+            uploadMeshPalette(instance, mesh, nodeData._meshCount, nodeData._compactVertices, lod);
+        }
+        else if(mesh != nullptr)
+        {
+            instance->_meshStale = false;
+            instance->_meshOptions = meshOptions;
+            instance->_palette = false;
+            instance->_lodLevels = 1;
+
+            assert(nodeData._meshCount <= MAX_MESH_MERGE);
+            acquireMeshBuffers(instance, mesh, nodeData._meshCount, nodeData._compactVertices);
+            instance->_meshSource = mesh[0].vertex_data;
+            instance->_meshCount = nodeData._meshCount;
+        }
+    }
+
+    // Checked every frame, the upcoming meshes load in the background
+    const MeshNodeData* mesh = *(nodeData._meshPtr);
+    const bool prefetch = mesh != nullptr && nodeData._meshCount == 1 && !instance->_palette;
+    prefetchMeshBuffers(instance, prefetch ? mesh[0].prefetch : nullptr, nodeData._compactVertices);
 
-                glUseProgram(_program_sobfilter);
-                glUniform1ui(glGetUniformLocation(_program_sobfilter, "meshCount"), nodeData._meshCount);
-                glUseProgram(_program_nrmpass);
-                glUniform1ui(glGetUniformLocation(_program_nrmpass, "meshCount"), nodeData._meshCount);
+    instance->_meshParam = instance->_palette ? 0.0f : nodeData._meshParam;
+
+    if(nodeData._repeatBlocks)
+    {
+        instance->_motifSize = nodeData._motifSize;
+        for(int c = 0; c < 3; c++) instance->_motifTiles[c] = nodeData._motifInstances[c];
+    }
+    else
+    {
+        for(int c = 0; c < 3; c++) instance->_motifTiles[c] = 0;
+    }
+
+    instance->_drawCount = instance->_instanceCount;
+    cullMotifTiles(instance, nodeData);
+
+    // The node wrote this frame's instances straight into the mapped slot
+    InstanceStreamSlot* streamSlot = instance->_streamRequested ? instance->_streamSlot : nullptr;
+    instance->_streamed = streamSlot != nullptr && streamSlot->written && instance->_stream.buffer != 0;
+    if(instance->_streamed)
+    {
+        streamSlot->written = false;
+        instance->bindStreamSlot();
+        instance->_positionOrigin = Vector3(0.0f, 0.0f, 0.0f);
+        instance->_positionExtent = Vector3(1.0f, 1.0f, 1.0f);
+    }
+    else
+    {
+        instance->bindInstanceAttributes(instance->_ipb, 0, nodeData._compactPositions, instance->_irb, 0, instance->_icb, 0);
+
+        // Motif tiles are culled instead (the instances repeat in every tile)
+        const bool positions = *(nodeData._worldPositionPtr) != nullptr;
+        const bool cull = nodeData._cullInstances && !nodeData._repeatBlocks && positions;
+        const bool lod = instance->_lodLevels > 1 && !nodeData._repeatBlocks && positions;
+        const bool palette = instance->_palette && positions && (*(nodeData._meshIndexPtr) != nullptr || lod);
+        if(cull || palette)
+        {
+            compactInstances(instance, nodeData, cull, palette, lod);
+        }
+        else
+        {
+            // The buffers only hold the last compacted instances
+            if(instance->_compacted)
+            {
+                instance->_compacted = false;
+                instance->_meshInstanceCounts.clear();
+                nodeData._instanceDirty->all(instance->_instanceCount);
             }
+            uploadInstances(instance, nodeData);
         }
+    }
 
-        glUseProgram(_program_sobfilter);
-        glUniform1f(_uniforms.all_meshParam, nodeData._meshParam);
-        glUseProgram(_program_nrmpass);
-        glUniform1f(_uniforms.all_meshParam, nodeData._meshParam);
-        // glUseProgram(_program_fogpart);
-        // glUniform1f(_uniforms.all_meshParam, nodeData._meshParam);
+    if(instance->_palette)
+    {
+        updateIndirectCommands(instance);
+    }
+}
 
-        if(outNode->outputs[0]->dataChanged())
+// Element buffer of a single mesh, non indexed meshes draw their vertices in order
+void RasterRenderer::DrawList::uploadMeshIndices(DrawInstance* instance, const MeshNodeData& mesh)
+{
+    if(!mesh.indexed())
+    {
+        instance->_indexType = 0;
+        return;
+    }
+
+    instance->_indexType = mesh.index_size == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+    // The element buffer binding belongs to the vertex array
+    glBindVertexArray(instance->_vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, instance->elementBuffer());
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.index_count * mesh.index_size, mesh.index_data, GL_STATIC_DRAW);
+    glBindVertexArray(0);
+}
+
+// Uploads the merged meshes into the drawn mesh buffers
+void RasterRenderer::DrawList::uploadMeshBuffers(DrawInstance* instance, const MeshNodeData* meshes, unsigned int count, bool compact)
+{
+    // Assuming all the meshes have the same attrs size (and triangles) at this point
+    instance->_idxcount = (GLsizei)meshes[0].elementCount();
+    uploadMeshIndices(instance, meshes[0]);
+
+    SetMeshVertexFormat(instance, meshes, count, compact);
+    const size_t totalSize = (meshes[0].data_size / 6) * MeshVertexSize(instance->_meshCompact);
+    for(unsigned int i = 0; i < count; i++)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, instance->meshBuffer(i));
+        glBufferData(GL_ARRAY_BUFFER, totalSize, nullptr, GL_STATIC_DRAW);
+        UploadMeshVertices(instance, meshes[i], 0, _verticesScratch);
+    }
+}
+
+// Uploads new shared buffers through the instance, which then draws them
+void RasterRenderer::DrawList::createMeshBuffers(DrawInstance* instance, SharedMeshBuffers& buffers, const MeshNodeData* meshes, unsigned int count, bool compact)
+{
+    glGenBuffers(MAX_MESH_MERGE, buffers.vbo);
+    glGenBuffers(1, &buffers.ebo);
+    instance->_sharedMesh = &buffers;
+    instance->bindMeshAttributes(instance->_meshCompact);
+    uploadMeshBuffers(instance, meshes, count, compact);
+
+    buffers.indexType = instance->_indexType;
+    buffers.idxcount = instance->_idxcount;
+    buffers.compact = instance->_meshCompact;
+    buffers.origin = instance->_meshOrigin;
+    buffers.extent = instance->_meshExtent;
+    buffers.radius = instance->_meshRadius;
+}
+
+// Meshes of shared assets are uploaded once for all the instances drawing them in the same format
+// Other meshes (e.g. interpolated ones) go to the instance's own buffers
+void RasterRenderer::DrawList::acquireMeshBuffers(DrawInstance* instance, const MeshNodeData* meshes, unsigned int count, bool compact)
+{
+    SharedMeshKey key = {};
+    key.compact = compact;
+    bool shared = true;
+    for(unsigned int i = 0; i < count; i++)
+    {
+        key.assets[i] = meshes[i].asset_id;
+        shared &= meshes[i].asset_id != 0;
+    }
+
+    // Assets never change their data, nothing to upload
+    if(shared && instance->_sharedMesh != nullptr && !(instance->_sharedMesh->key < key) && !(key < instance->_sharedMesh->key))
+    {
+        return;
+    }
+
+    releaseMeshBuffers(instance);
+    if(!shared)
+    {
+        uploadMeshBuffers(instance, meshes, count, compact);
+        return;
+    }
+
+    auto [it, created] = _sharedMeshes.try_emplace(key);
+    SharedMeshBuffers& buffers = it->second;
+    buffers.users++;
+    instance->_sharedMesh = &buffers;
+
+    if(created)
+    {
+        buffers.key = key;
+        createMeshBuffers(instance, buffers, meshes, count, compact);
+    }
+    else
+    {
+        instance->_indexType = buffers.indexType;
+        instance->_idxcount = buffers.idxcount;
+        instance->_meshOrigin = buffers.origin;
+        instance->_meshExtent = buffers.extent;
+        instance->_meshRadius = buffers.radius;
+        instance->bindMeshAttributes(buffers.compact);
+    }
+}
+
+// Switches the instance back to its own mesh buffers
+void RasterRenderer::DrawList::releaseMeshBuffers(DrawInstance* instance)
+{
+    SharedMeshBuffers* buffers = instance->_sharedMesh;
+    if(buffers == nullptr) return;
+
+    instance->_sharedMesh = nullptr;
+    instance->bindMeshAttributes(instance->_meshCompact);
+    releaseSharedMeshBuffers(buffers);
+}
+
+void RasterRenderer::DrawList::releaseSharedMeshBuffers(SharedMeshBuffers* buffers)
+{
+    if(--buffers->users == 0)
+    {
+        glDeleteBuffers(MAX_MESH_MERGE, buffers->vbo);
+        glDeleteBuffers(1, &buffers->ebo);
+        _sharedMeshes.erase(buffers->key);
+    }
+}
+
+// Holds shared buffers for the meshes the instance draws next, acquiring one of them later uploads nothing
+// At most one new mesh is uploaded per frame, so a sequence never stalls on several frames at once
+// Buffers of meshes no longer listed are released (a nullptr list releases them all)
+void RasterRenderer::DrawList::prefetchMeshBuffers(DrawInstance* instance, const MeshPrefetchList* list, bool compact)
+{
+    if(list == nullptr && instance->_prefetchedMeshes.empty()) return;
+
+    std::vector<SharedMeshBuffers*> held;
+    bool uploaded = false;
+    for(unsigned int i = 0; list != nullptr && i < list->count; i++)
+    {
+        const MeshNodeData& mesh = list->meshes[i];
+        if(mesh.asset_id == 0) continue;
+
+        // Same key acquireMeshBuffers uses for a single mesh
+        SharedMeshKey key = {};
+        key.assets[0] = mesh.asset_id;
+        key.compact = compact;
+
+        auto it = _sharedMeshes.find(key);
+        if(it == _sharedMeshes.end())
         {
-            if(nodeData._fogChanged)
+            if(uploaded) continue;
+            uploaded = true;
+
+            // The instance keeps drawing its current mesh
+            SharedMeshBuffers* drawn = instance->_sharedMesh;
+            const GLenum indexType = instance->_indexType;
+            const GLsizei idxcount = instance->_idxcount;
+            const bool meshCompact = instance->_meshCompact;
+            const Vector3 origin = instance->_meshOrigin;
+            const Vector3 extent = instance->_meshExtent;
+            const float radius = instance->_meshRadius;
+
+            it = _sharedMeshes.try_emplace(key).first;
+            it->second.key = key;
+            createMeshBuffers(instance, it->second, &mesh, 1, compact);
+
+            instance->_sharedMesh = drawn;
+            instance->_indexType = indexType;
+            instance->_idxcount = idxcount;
+            instance->_meshOrigin = origin;
+            instance->_meshExtent = extent;
+            instance->_meshRadius = radius;
+            instance->bindMeshAttributes(meshCompact);
+        }
+
+        if(std::find(held.begin(), held.end(), &it->second) == held.end())
+        {
+            it->second.users++;
+            held.push_back(&it->second);
+        }
+    }
+
+    // Released after the new ones are held, so buffers staying in the list are not freed in between
+    for(SharedMeshBuffers* buffers : instance->_prefetchedMeshes)
+    {
+        releaseSharedMeshBuffers(buffers);
+    }
+    instance->_prefetchedMeshes = std::move(held);
+}
+
+// Packs every palette mesh into the shared vertex and element buffers, each mesh is a range of both
+// Indices stay local to their mesh (the commands base vertex offsets them), non indexed meshes get sequential ones
+// With lod every level of detail is an extra index range over the mesh vertices
+void RasterRenderer::DrawList::uploadMeshPalette(DrawInstance* instance, const MeshNodeData* meshes, unsigned int count, bool compact, bool lod)
+{
+    unsigned int levels = 1;
+    if(lod)
+    {
+        for(unsigned int i = 0; i < count; i++)
+        {
+            if(meshes[i].indexed()) levels = std::max(levels, 1 + std::min(meshes[i].lod_count, MESH_MAX_LODS));
+        }
+    }
+
+    // Palettes are packed per instance
+    releaseMeshBuffers(instance);
+
+    instance->_palette = true;
+    instance->_lodLevels = levels;
+    instance->_paletteFirstIndex.resize(count * levels);
+    instance->_paletteBaseVertex.resize(count * levels);
+    instance->_paletteCount.resize(count * levels);
+    instance->_paletteError.resize(count * levels);
+    instance->_lodScale = 0.0f;
+
+    size_t vertices = 0;
+    size_t indices = 0;
+    bool wide = false;
+    for(unsigned int i = 0; i < count; i++)
+    {
+        const size_t meshVertices = meshes[i].data_size / 6;
+        const unsigned int meshLevels = meshes[i].indexed() ? 1 + std::min(meshes[i].lod_count, MESH_MAX_LODS) : 1;
+        for(unsigned int l = 0; l < levels; l++)
+        {
+            const unsigned int r = i * levels + l;
+            if(l < meshLevels)
             {
-                // NOTE: Using glGetUniformLocation should be ok: this won't change that often and I'm lazy
-                glUseProgram(_program_sobfilter);
-                glUniform1f(glGetUniformLocation(_program_sobfilter, "fogMax"), nodeData._fogMax);
-                glUniform1f(glGetUniformLocation(_program_sobfilter, "fogMin"), nodeData._fogMin);
-                // fogcolor is background basically (no volumetric fog)
-                glClearColor(nodeData._fogColor.x, nodeData._fogColor.y, nodeData._fogColor.z, 1.0f);
+                instance->_paletteFirstIndex[r] = (GLuint)indices;
+                instance->_paletteCount[r] = (GLsizei)meshes[i].lodElementCount(l);
+                instance->_paletteError[r] = meshes[i].lodError(l);
+                indices += meshes[i].lodElementCount(l);
             }
+            else
+            {
+                // Missing levels repeat the coarsest one and are never selected
+                instance->_paletteFirstIndex[r] = instance->_paletteFirstIndex[r - 1];
+                instance->_paletteCount[r] = instance->_paletteCount[r - 1];
+                instance->_paletteError[r] = INFINITY;
+            }
+            instance->_paletteBaseVertex[r] = (GLint)vertices;
+        }
+        vertices += meshVertices;
+        wide |= meshVertices > 65536;
+    }
 
-            glUseProgram(_program_sobfilter);
-            glUniform1f(glGetUniformLocation(_program_sobfilter, "fogMax"), nodeData._fogMax);
+    SetMeshVertexFormat(instance, meshes, count, compact);
+    glBindBuffer(GL_ARRAY_BUFFER, instance->_vbo[0]);
+    glBufferData(GL_ARRAY_BUFFER, vertices * MeshVertexSize(instance->_meshCompact), nullptr, GL_STATIC_DRAW);
+
+    const size_t indexSize = wide ? sizeof(uint32_t) : sizeof(uint16_t);
+    std::vector<uint8_t>& packed = _indicesScratch;
+    packed.resize(indices * indexSize);
 
-            if(nodeData._repeatBlocks && nodeData._motifChanged)
+    for(unsigned int i = 0; i < count; i++)
+    {
+        UploadMeshVertices(instance, meshes[i], instance->_paletteBaseVertex[i * levels], _verticesScratch);
+
+        const unsigned int meshLevels = meshes[i].indexed() ? 1 + std::min(meshes[i].lod_count, MESH_MAX_LODS) : 1;
+        for(unsigned int l = 0; l < std::min(levels, meshLevels); l++)
+        {
+            uint8_t* out = packed.data() + instance->_paletteFirstIndex[i * levels + l] * indexSize;
+            for(size_t k = 0; k < meshes[i].lodElementCount(l); k++)
             {
-                Renderer::SetGlobalSceneMotif(nodeData._motifSize); // NOTE : This only works for a single active render node like this
-                instances[0]->_motif_span = nodeData._motif_span;
+                const uint32_t index = meshes[i].lodIndex(l, k);
+                if(wide) ((uint32_t*)out)[k] = index;
+                else     ((uint16_t*)out)[k] = (uint16_t)index;
+            }
+        }
+    }
 
-                glm::mat4* mpos = *(nodeData._motifPositionPtr);
-                if(mpos != nullptr)
-                {
-                    glBindBuffer(GL_ARRAY_BUFFER, instances[0]->_mpb);
-                    glBufferData(GL_ARRAY_BUFFER, instances[0]->_motif_span * instances[0]->_instanceCount * sizeof(glm::mat4), mpos, GL_DYNAMIC_DRAW);
-                    instances[0]->updateMotifInstanceForVertexArray();
-                }
-                // FIXME : Fog Updater SLOOOOW
-                // updateFogParticlesMotifSize();
+    instance->_indexType = wide ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+    glBindVertexArray(instance->_vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, instance->_ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, packed.size(), packed.data(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+
+    instance->_idxcount = (GLsizei)indices;
+    instance->_meshSource = meshes[0].vertex_data;
+    instance->_meshCount = 1;
+
+    // Regroup the instances for the new palette
+    instance->_meshInstanceCounts.clear();
+    instance->_compacted = false;
+}
+
+// Only sets the uniforms that differ from the previous draw
+void RasterRenderer::DrawList::drawInstance(const DrawInstance* instance, const DrawInstance* last)
+{
+    if(instance->_visibleTiles.empty()) return;
+
+    if(last == nullptr || last->_meshCount != instance->_meshCount)
+    {
+        glUniform1ui(_uniforms.meshCount, instance->_meshCount);
+    }
+    if(last == nullptr || last->_meshParam != instance->_meshParam)
+    {
+        glUniform1f(_uniforms.all_meshParam, instance->_meshParam);
+    }
+    if(last == nullptr || last->_meshOrigin != instance->_meshOrigin || last->_meshExtent != instance->_meshExtent || last->_meshCompact != instance->_meshCompact)
+    {
+        glUniform3fv(_uniforms.meshOrigin, 1, instance->_meshOrigin.data);
+        glUniform3fv(_uniforms.meshExtent, 1, instance->_meshExtent.data);
+        glUniform1i(_uniforms.meshCompact, instance->_meshCompact);
+    }
+    if(last == nullptr || last->_positionOrigin != instance->_positionOrigin || last->_positionExtent != instance->_positionExtent)
+    {
+        glUniform3fv(_uniforms.instanceOrigin, 1, instance->_positionOrigin.data);
+        glUniform3fv(_uniforms.instanceExtent, 1, instance->_positionExtent.data);
+    }
+    if(last == nullptr || last->_motifSize != instance->_motifSize || memcmp(last->_motifTiles, instance->_motifTiles, sizeof(instance->_motifTiles)) != 0)
+    {
+        glUniform3fv(_uniforms.motifSize, 1, instance->_motifSize.data);
+        glUniform3ui(_uniforms.motifTiles, instance->_motifTiles[0], instance->_motifTiles[1], instance->_motifTiles[2]);
+    }
+    if(last == nullptr || last->_motif_span != instance->_motif_span)
+    {
+        glUniform1ui(_uniforms.motifSpan, instance->_motif_span);
+    }
+
+    glBindVertexArray(instance->_vao);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, instance->_vtb);
+
+    if(instance->_palette)
+    {
+        // Every palette mesh in a single call
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, instance->_indirect);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, instance->_indexType, nullptr, (GLsizei)instance->_commands.size(), 0);
+    }
+    else if(instance->_indexType != 0)
+    {
+        glDrawElementsInstanced(GL_TRIANGLES, instance->_idxcount, instance->_indexType, nullptr, instance->_drawCount * instance->_motif_span);
+    }
+    else
+    {
+        glDrawArraysInstanced(GL_TRIANGLES, 0, instance->_idxcount, instance->_drawCount * instance->_motif_span);
+    }
+}
+
+void RasterRenderer::DrawList::handOverStreamSlot(DrawInstance* instance)
+{
+    if(instance->_streamed)
+    {
+        instance->fenceStreamSlot();
+    }
+
+    InstanceStreamSlot* streamSlot = instance->_streamRequested ? instance->_streamSlot : nullptr;
+    if(streamSlot != nullptr)
+    {
+        if(streamSlot->requested > instance->_stream.capacity)
+        {
+            instance->createStreamRing(streamSlot->requested + streamSlot->requested / 2);
+        }
+
+        if(instance->_stream.buffer != 0)
+        {
+            instance->publishStreamSlot(streamSlot);
+        }
+    }
+    else if(instance->_stream.buffer != 0)
+    {
+        instance->destroyStreamRing();
+        if(instance->_streamSlot != nullptr)
+        {
+            *(instance->_streamSlot) = InstanceStreamSlot();
+        }
+    }
+}
+
+// Keeps the motif tiles that might be visible: inside the fog distance and intersecting the view frustum
+// Tiles are indexed as x + y * nx + z * nx * ny over the [-n, n] grid, the vertex shader decodes the offsets
+void RasterRenderer::DrawList::cullMotifTiles(DrawInstance* instance, const RenderNodeData& nodeData)
+{
+    std::vector<unsigned int>& visible = _tilesScratch;
+    visible.clear();
+
+    if(!nodeData._repeatBlocks)
+    {
+        visible.push_back(0);
+    }
+    else
+    {
+        // Tile contents: the instance bounds grown by the mesh radius, or the motif cell when those are unknown
+        Vector3 lo = nodeData._motifSize * -0.5f;
+        Vector3 hi = nodeData._motifSize * 0.5f;
+        if(nodeData._instanceBoundsValid)
+        {
+            const Vector3 r = Vector3(instance->_meshRadius, instance->_meshRadius, instance->_meshRadius);
+            lo = nodeData._instanceBoundsMin - r;
+            hi = nodeData._instanceBoundsMax + r;
+        }
+
+        const Vector3 eye = camera->getPosition();
+        const float fog = nodeData._fogMax;
+        const glm::mat4 viewProjection = camera->projectionMatrix * camera->viewMatrix;
+        const Math::Frustum frustum = Math::ExtractFrustum(&viewProjection[0][0]);
+
+        // Tile range per axis whose slab is within the fog distance
+        int first[3], last[3], side[3];
+        for(int c = 0; c < 3; c++)
+        {
+            const int n = (int)nodeData._motifInstances[c];
+            const float s = nodeData._motifSize.data[c];
+            side[c] = 2 * n + 1;
+            first[c] = 0;
+            last[c] = 2 * n;
+            if(s > 0.0f)
+            {
+                first[c] = std::max(first[c], n + (int)std::ceil((eye.data[c] - fog - hi.data[c]) / s));
+                last[c] = std::min(last[c], n + (int)std::floor((eye.data[c] + fog - lo.data[c]) / s));
             }
-            else if(!nodeData._repeatBlocks)
+        }
+
+        const float fog2 = fog * fog;
+        for(int z = first[2]; z <= last[2]; z++)
+        {
+            for(int y = first[1]; y <= last[1]; y++)
             {
-                instances[0]->_motif_span = 1;
-                glBindBuffer(GL_ARRAY_BUFFER, instances[0]->_mpb);
-                glm::mat4 identity = glm::mat4(1.0f);
-                glBufferData(GL_ARRAY_BUFFER, sizeof(glm::mat4), &identity, GL_DYNAMIC_DRAW);
-                instances[0]->updateMotifInstanceForVertexArray();
-                glBindVertexArray(instances[0]->_vao);
-                glVertexAttribDivisor(10, instances[0]->_instanceCount);
-                glVertexAttribDivisor(11, instances[0]->_instanceCount);
-                glVertexAttribDivisor(12, instances[0]->_instanceCount);
-                glVertexAttribDivisor(13, instances[0]->_instanceCount);
-
-                Renderer::SetGlobalSceneMotif(infinityVec3);
-
-                // FIXME : Take care of this please
-                // updateFogParticlesMotifSize();
+                for(int x = first[0]; x <= last[0]; x++)
+                {
+                    const Vector3 offset = Vector3((float)(x - side[0] / 2), (float)(y - side[1] / 2), (float)(z - side[2] / 2)) * nodeData._motifSize;
+                    const Vector3 min = lo + offset;
+                    const Vector3 max = hi + offset;
+
+                    if(Math::AabbDistanceSquared(eye, min, max) > fog2) continue;
+                    if(Math::AabbOutsideFrustum(frustum, min, max)) continue;
+
+                    visible.push_back((unsigned int)(x + y * side[0] + z * side[0] * side[1]));
+                }
             }
         }
+    }
 
-        Vector4* pos = *(nodeData._worldPositionPtr);
-        if(pos != nullptr)
+    if(visible == instance->_visibleTiles) return;
+    instance->_visibleTiles.swap(visible);
+
+    const unsigned int span = (unsigned int)instance->_visibleTiles.size();
+    if(span > 0)
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, instance->_vtb);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, span * sizeof(unsigned int), instance->_visibleTiles.data(), GL_DYNAMIC_DRAW);
+
+        if(span != instance->_motif_span)
         {
-            glBindBuffer(GL_ARRAY_BUFFER, instances[0]->_ipb);
-            glBufferData(GL_ARRAY_BUFFER, instances[0]->_instanceCount * sizeof(Vector4), pos, GL_DYNAMIC_DRAW);
+            instance->_motif_span = span;
+            instance->updateMotifInstanceForVertexArray();
         }
+    }
+}
+
+// Gathers the listed instances and uploads them, packed, to the start of buffer
+template<typename T>
+static void UploadGatheredInstances(GLuint buffer, GLsizeiptr* capacity, const T* src, const std::vector<unsigned int>& indices, std::vector<unsigned char>& scratch)
+{
+    const size_t count = indices.size();
+    scratch.resize(count * sizeof(T));
+
+    T* dst = (T*)scratch.data();
+    const unsigned int* idx = indices.data();
+    Utils::ParallelFor(count, GATHER_MIN_INSTANCES_PER_THREAD, [=](size_t begin, size_t end) {
+        for(size_t i = begin; i < end; i++) dst[i] = src[idx[i]];
+    });
+
+    InstanceDirtyRange all;
+    all.add(0, (unsigned int)count);
+    UploadInstanceRange(buffer, capacity, dst, sizeof(T), (unsigned int)count, &all);
+}
+
+// Uploads the instances compacted: only the visible ones (culling), grouped by palette mesh (mesh palette)
+// Nothing is uploaded when neither the instances nor the selected set changed
+void RasterRenderer::DrawList::compactInstances(DrawInstance* instance, const RenderNodeData& nodeData, bool cull, bool palette, bool lod)
+{
+    InstanceDirtyRanges* dirty = nodeData._instanceDirty;
+    const Vector3* positions = *(nodeData._worldPositionPtr);
+
+    bool changed = false;
+    const int mode = (cull ? 1 : 0) | (palette ? 2 : 0) | (lod ? 4 : 0);
+    if(!instance->_compacted || instance->_compactMode != mode)
+    {
+        instance->_compacted = true;
+        instance->_compactMode = mode;
+        instance->_culler.invalidate();
+        changed = true;
+    }
+
+    changed |= !dirty->position.empty() || !dirty->rotation.empty() || !dirty->color.empty() || !dirty->mesh.empty();
+
+    // Levels of detail are reselected whenever the camera moves
+    bool relod = false;
+    if(lod)
+    {
+        const Vector3 eye = camera->getPosition();
+        const float scale = camera->projectionMatrix[1][1] * 0.5f * _screen_render_data->screen_size[1] / std::max(nodeData._lodPixelError, 0.01f);
+        relod = eye != instance->_lodEye || scale != instance->_lodScale;
+        instance->_lodEye = eye;
+        instance->_lodScale = scale;
+    }
+
+    std::vector<unsigned int>& selected = _instancesScratch;
+    if(cull)
+    {
+        instance->_culler.refresh(positions, instance->_instanceCount, dirty->position);
+
+        const glm::mat4 viewProjection = camera->projectionMatrix * camera->viewMatrix;
+        const Math::Frustum frustum = Math::ExtractFrustum(&viewProjection[0][0]);
+        instance->_culler.cull(positions, frustum, instance->_meshRadius, selected);
+    }
+    else if(changed || relod)
+    {
+        selected.resize(instance->_instanceCount);
+        std::iota(selected.begin(), selected.end(), 0u);
+    }
+    else
+    {
+        // Every instance, nothing changed
+        instance->_drawCount = (unsigned int)instance->_visibleInstances.size();
+        return;
+    }
+
+    if(palette)
+    {
+        groupInstancesByMesh(instance, nodeData, selected, lod);
+    }
+    instance->_drawCount = (unsigned int)selected.size();
+
+    if(!changed && selected == instance->_visibleInstances) return;
+    instance->_visibleInstances.swap(selected);
+
+    dirty->position.clear();
+    dirty->rotation.clear();
+    dirty->color.clear();
+    dirty->mesh.clear();
+
+    const std::vector<unsigned int>& indices = instance->_visibleInstances;
+    if(nodeData._compactPositions && *(nodeData._worldPositionCompactPtr) != nullptr)
+    {
+        UploadGatheredInstances(instance->_ipb, &instance->_ipbCapacity, *(nodeData._worldPositionCompactPtr), indices, _gatherScratch);
+    }
+    else
+    {
+        UploadGatheredInstances(instance->_ipb, &instance->_ipbCapacity, positions, indices, _gatherScratch);
+    }
+
+    instance->_positionOrigin = nodeData._positionOrigin;
+    instance->_positionExtent = nodeData._positionExtent;
+
+    const Vector3* rot = *(nodeData._worldRotationPtr);
+    if(rot != nullptr)
+    {
+        UploadGatheredInstances(instance->_irb, &instance->_irbCapacity, rot, indices, _gatherScratch);
+    }
 
-        glm::mat4* rot = *(nodeData._worldRotationPtr);
-        if(rot != nullptr)
+    const InstanceColor8* col = *(nodeData._instanceColorsPtr);
+    if(col != nullptr)
+    {
+        UploadGatheredInstances(instance->_icb, &instance->_icbCapacity, col, indices, _gatherScratch);
+    }
+}
+
+// Stable sort of the selected instances by palette range (a radix sort on the mesh index and level of detail), counting the instances of each range
+// The level is the coarsest one whose error projects below the pixel error at the instance distance
+void RasterRenderer::DrawList::groupInstancesByMesh(DrawInstance* instance, const RenderNodeData& nodeData, std::vector<unsigned int>& selected, bool lod)
+{
+    const unsigned int* meshIndex = *(nodeData._meshIndexPtr);
+    const Vector3* positions = *(nodeData._worldPositionPtr);
+    const unsigned int levels = instance->_lodLevels;
+    const unsigned int last = (unsigned int)instance->_paletteCount.size() - 1;
+    const unsigned int lastMesh = (unsigned int)instance->_paletteCount.size() / levels - 1;
+
+    // Levels are kept ordered by distance even when a coarser one has less error
+    std::vector<float>& distance = instance->_lodDistance;
+    distance.resize(instance->_paletteError.size());
+    for(size_t r = 0; r < distance.size(); r++)
+    {
+        const float error = instance->_paletteError[r];
+        distance[r] = (r % levels == 0) ? 0.0f : (error == INFINITY ? INFINITY : std::max(error * instance->_lodScale, distance[r - 1]));
+    }
+
+    std::vector<uint32_t>& keys = _meshKeysScratch;
+    keys.resize(selected.size());
+
+    uint32_t* k = keys.data();
+    const unsigned int* idx = selected.data();
+    const float* d = distance.data();
+    const Vector3 eye = instance->_lodEye;
+    const float radius = instance->_meshRadius;
+    Utils::ParallelFor(selected.size(), GATHER_MIN_INSTANCES_PER_THREAD, [=](size_t begin, size_t end) {
+        for(size_t i = begin; i < end; i++)
         {
-            glBindBuffer(GL_ARRAY_BUFFER, instances[0]->_irb);
-            glBufferData(GL_ARRAY_BUFFER, instances[0]->_instanceCount * sizeof(glm::mat4), rot, GL_DYNAMIC_DRAW);
+            const unsigned int m = meshIndex != nullptr ? std::min(meshIndex[idx[i]], lastMesh) : 0;
+            unsigned int l = 0;
+            if(lod)
+            {
+                const Vector3 v = positions[idx[i]] - eye;
+                const float dist = std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z) - radius;
+                for(l = levels - 1; l > 0 && dist < d[m * levels + l]; l--);
+            }
+            k[i] = m * levels + l;
         }
+    });
+
+    unsigned int keyBits = 1;
+    while(keyBits < 32 && (last >> keyBits) != 0) keyBits++;
+    Math::ParallelRadixSort(keys, selected, keyBits);
 
-        Vector4* col = *(nodeData._instanceColorsPtr);
-        if(col != nullptr)
+    instance->_meshInstanceCounts.resize(last + 1);
+    for(unsigned int m = 0; m <= last; m++)
+    {
+        auto range = std::equal_range(keys.begin(), keys.end(), m);
+        instance->_meshInstanceCounts[m] = (unsigned int)(range.second - range.first);
+    }
+}
+
+// One indirect draw per palette range, each over its (contiguous) instances
+void RasterRenderer::DrawList::updateIndirectCommands(DrawInstance* instance)
+{
+    std::vector<DrawElementsIndirectCommand>& commands = _commandsScratch;
+    commands.clear();
+
+    if(instance->_streamed || instance->_meshInstanceCounts.size() != instance->_paletteCount.size())
+    {
+        // Instances are not grouped (streamed, which is never done with a mesh palette), they all draw the first mesh
+        commands.push_back({ (GLuint)instance->_paletteCount[0], instance->_drawCount * instance->_motif_span, instance->_paletteFirstIndex[0], instance->_paletteBaseVertex[0], 0 });
+    }
+    else
+    {
+        GLuint baseInstance = 0;
+        for(size_t m = 0; m < instance->_paletteCount.size(); m++)
         {
-            glBindBuffer(GL_ARRAY_BUFFER, instances[0]->_icb);
-            glBufferData(GL_ARRAY_BUFFER, instances[0]->_instanceCount * sizeof(Vector4), col, GL_DYNAMIC_DRAW);
+            const GLuint count = instance->_meshInstanceCounts[m];
+            if(count > 0 && instance->_paletteCount[m] > 0)
+            {
+                commands.push_back({ (GLuint)instance->_paletteCount[m], count * instance->_motif_span, instance->_paletteFirstIndex[m], instance->_paletteBaseVertex[m], baseInstance });
+            }
+            baseInstance += count;
         }
     }
 
-    // Render using normals to create an image to the sobel filter for edge detection
-    glUseProgram(_program_nrmpass);
-    glUniformMatrix4fv(_uniforms.viewMatrix, 1, GL_FALSE, &camera->viewMatrix[0][0]);
-    glBindFramebuffer(GL_FRAMEBUFFER, _rendertarget.framebuffer_id);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glBindVertexArray(instances[0]->_vao);
+    if(commands == instance->_commands) return;
+    instance->_commands.swap(commands);
 
-    glDrawArraysInstanced(GL_TRIANGLES, 0, instances[0]->_idxcount, instances[0]->_instanceCount * instances[0]->_motif_span);
+    if(!instance->_commands.empty())
+    {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, instance->_indirect);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, instance->_commands.size() * sizeof(DrawElementsIndirectCommand), instance->_commands.data(), GL_DYNAMIC_DRAW);
+    }
+}
 
+void RasterRenderer::DrawList::uploadInstances(DrawInstance* instance, const RenderNodeData& nodeData)
+{
+    // Upload only what the render node modified since the last frame
+    InstanceDirtyRanges* dirty = nodeData._instanceDirty;
+
+    const void* pos = nodeData._compactPositions ? (const void*)*(nodeData._worldPositionCompactPtr) : (const void*)*(nodeData._worldPositionPtr);
+    const size_t posSize = nodeData._compactPositions ? sizeof(InstancePosition16) : sizeof(Vector3);
+    if(pos != nullptr)
+    {
+        UploadInstanceRange(instance->_ipb, &instance->_ipbCapacity, pos, posSize, instance->_instanceCount, &dirty->position);
+    }
+
+    instance->_positionOrigin = nodeData._positionOrigin;
+    instance->_positionExtent = nodeData._positionExtent;
+
+    Vector3* rot = *(nodeData._worldRotationPtr);
+    if(rot != nullptr)
+    {
+        UploadInstanceRange(instance->_irb, &instance->_irbCapacity, rot, sizeof(Vector3), instance->_instanceCount, &dirty->rotation);
+    }
+
+    InstanceColor8* col = *(nodeData._instanceColorsPtr);
+    if(col != nullptr)
+    {
+        UploadInstanceRange(instance->_icb, &instance->_icbCapacity, col, sizeof(InstanceColor8), instance->_instanceCount, &dirty->color);
+    }
+}
+
+void RasterRenderer::DrawList::drawPostProcess()
+{
     // FIXME : Fog/dust particles rendering by putting them at the origin with camera scroll
     // Render fog and particles to the final texture for displaying
     float time = (float)NodeWindow::GetApptimeMs() / 1000.0f;
@@ -1,14 +1,18 @@
 #pragma once
 #include <vector>
 #include <unordered_map>
+#include <map>
 #include "../../glm/glm/glm.hpp"
 #include "../windows/node_window.h"
 #include "../windows/analytics_window.h"
 #include "../windows/options_window.h"
 #include "../math/vector.h"
+#include "node_outputs.h"
+#include "instance_culler.h"
 #include "../util/misc.inl"
 
 struct GLFWwindow;
+struct PropertyNode;
 
 namespace Renderer
 {
@@ -19,33 +23,167 @@ namespace Renderer
 namespace RasterRenderer
 {
     constexpr unsigned int MAX_MESH_MERGE = 2;
+    constexpr unsigned int STREAM_RING_SIZE = 3;
+
+    // Persistently mapped (coherent) instance attributes, one slot per frame in flight
+    // Each slot holds positions, rotations and colors for capacity instances and is guarded by a fence
+    struct InstanceStreamRing
+    {
+        GLuint         buffer = 0;
+        unsigned char* mapped = nullptr;
+        unsigned int   capacity = 0;
+        GLsizeiptr     slotSize = 0;
+        unsigned int   slot = 0;
+        GLsync         fences[STREAM_RING_SIZE] = {};
+    };
+
+    // Same layout as the GL indirect draw elements command
+    struct DrawElementsIndirectCommand
+    {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint  baseVertex;
+        GLuint baseInstance;
+
+        inline bool operator==(const DrawElementsIndirectCommand& rhs) const
+        {
+            return count == rhs.count && instanceCount == rhs.instanceCount && firstIndex == rhs.firstIndex && baseVertex == rhs.baseVertex && baseInstance == rhs.baseInstance;
+        }
+    };
+
+    // Asset ids of the merged meshes (see MeshNodeData::asset_id) and the requested vertex format
+    struct SharedMeshKey
+    {
+        uint64_t assets[MAX_MESH_MERGE];
+        bool     compact;
+
+        inline bool operator<(const SharedMeshKey& rhs) const
+        {
+            for(unsigned int i = 0; i < MAX_MESH_MERGE; i++)
+            {
+                if(assets[i] != rhs.assets[i]) return assets[i] < rhs.assets[i];
+            }
+            return compact < rhs.compact;
+        }
+    };
+
+    // Mesh buffers uploaded once for every instance drawing the same assets, freed with their last user
+    struct SharedMeshBuffers
+    {
+        SharedMeshKey key;
+        GLuint        vbo[MAX_MESH_MERGE];
+        GLuint        ebo;
+        GLenum        indexType;
+        GLsizei       idxcount;
+        bool          compact;
+        Vector3       origin;
+        Vector3       extent;
+        float         radius;
+        unsigned int  users = 0;
+    };
 
     struct DrawInstance
     {
         DrawInstance();
         ~DrawInstance();
 
+        // Mesh buffers drawn, either shared or the instance's own
+        inline GLuint meshBuffer(unsigned int i) const
+        {
+            return _sharedMesh != nullptr ? _sharedMesh->vbo[i] : _vbo[i];
+        }
+
+        inline GLuint elementBuffer() const
+        {
+            return _sharedMesh != nullptr ? _sharedMesh->ebo : _ebo;
+        }
+
         void updateMotifInstanceForVertexArray();
+        void bindMeshAttributes(bool compact);
+        void bindInstanceAttributes(GLuint positions, GLintptr positionsOffset, bool compact, GLuint rotations, GLintptr rotationsOffset, GLuint colors, GLintptr colorsOffset);
+
+        void createStreamRing(unsigned int capacity);
+        void destroyStreamRing();
+        void bindStreamSlot();
+        void fenceStreamSlot();
+        void publishStreamSlot(InstanceStreamSlot* slot);
+
+        PropertyNode* _node; // The render node this instance draws (nullptr for the default one)
 
         GLuint  _vao;
         GLuint  _vbo[MAX_MESH_MERGE];
-        GLuint  _ebo; // Unused
+        GLuint  _ebo;
+        GLenum  _indexType; // GL_UNSIGNED_SHORT / GL_UNSIGNED_INT, 0 draws the vertices in order
         GLsizei _idxcount;
 
+        SharedMeshBuffers* _sharedMesh; // Drawn instead of _vbo / _ebo when set
+
+        // Shared buffers of the meshes drawn next (see MeshNodeData::prefetch), held so switching to them uploads nothing
+        std::vector<SharedMeshBuffers*> _prefetchedMeshes;
+
+        // Vertices uploaded as Math::MeshVertex16, quantized inside the mesh bounds
+        bool    _meshCompact;
+        Vector3 _meshOrigin;
+        Vector3 _meshExtent;
+
         GLuint      _ipb;
-        Vector4**   _intancePositionMatrixPtr;
+        GLsizeiptr  _ipbCapacity;
+        Vector3**   _intancePositionMatrixPtr;
 
         GLuint      _irb;
-        glm::mat4** _intanceRotationMatrixPtr;
+        GLsizeiptr  _irbCapacity;
+        Vector3**   _intanceRotationMatrixPtr;
+
+        GLuint           _icb;
+        GLsizeiptr       _icbCapacity;
+        InstanceColor8** _instanceColorsPtr;
+
+        InstanceStreamRing  _stream;
+        InstanceStreamSlot* _streamSlot;
+        bool                _streamRequested;
+        bool                _streamed; // Drawn from the ring this frame
 
-        GLuint      _icb;
-        Vector4**   _instanceColorsPtr;
+        // Indices of the motif tiles that survived culling (shader storage buffer)
+        GLuint                    _vtb;
+        std::vector<unsigned int> _visibleTiles;
+        float                     _meshRadius;
 
-        GLuint      _mpb;
-        Vector4**   _motifPositionMatrixPtr;
+        // Compacted instances (frustum culling or mesh palette), the attribute buffers then hold the selected instances only
+        InstanceCuller            _culler;
+        std::vector<unsigned int> _visibleInstances;
+        bool                      _compacted;
+        int                       _compactMode;
+
+        // Mesh palette: every mesh is a vertex range of _vbo[0] and an index range of _ebo, drawn from one indirect command buffer
+        // With levels of detail each mesh has _lodLevels index ranges, range mesh * _lodLevels + level
+        bool                                     _palette;
+        unsigned int                             _lodLevels;
+        std::vector<GLuint>                      _paletteFirstIndex;
+        std::vector<GLint>                       _paletteBaseVertex;
+        std::vector<GLsizei>                     _paletteCount;
+        std::vector<float>                       _paletteError; // Object space error of every range (infinite for missing levels)
+        std::vector<float>                       _lodDistance;  // Camera distance where every range starts
+        Vector3                                  _lodEye;
+        float                                    _lodScale;
+        int                                      _meshOptions; // Vertex format and levels of detail of the uploaded meshes
+        std::vector<unsigned int>                _meshInstanceCounts;
+        std::vector<DrawElementsIndirectCommand> _commands;
+        GLuint                                   _indirect;
 
         unsigned int _instanceCount;
+        unsigned int _drawCount; // Instances drawn per motif tile
         unsigned int _motif_span;
+
+        // Per draw shader state
+        const float* _meshSource; // Draws are sorted by it
+        bool         _meshStale;
+        unsigned int _meshCount;
+        float        _meshParam;
+        Vector3      _positionOrigin;
+        Vector3      _positionExtent;
+        Vector3      _motifSize;
+        unsigned int _motifTiles[3];
     };
 
     struct DrawList
@@ -55,6 +193,25 @@ namespace RasterRenderer
 
         void render(GLFWwindow* window, NodeWindow* nodeWindow, AnalyticsWindow* analyticsWindow, OptionsWindow* optionsWindow);
 
+        void syncInstances(NodeWindow* nodeWindow);
+        void prepareInstance(DrawInstance* instance);
+        void drawInstance(const DrawInstance* instance, const DrawInstance* last);
+        void handOverStreamSlot(DrawInstance* instance);
+        void uploadInstances(DrawInstance* instance, const RenderNodeData& nodeData);
+        void cullMotifTiles(DrawInstance* instance, const RenderNodeData& nodeData);
+        void compactInstances(DrawInstance* instance, const RenderNodeData& nodeData, bool cull, bool palette, bool lod);
+        void groupInstancesByMesh(DrawInstance* instance, const RenderNodeData& nodeData, std::vector<unsigned int>& selected, bool lod);
+        void updateIndirectCommands(DrawInstance* instance);
+        void uploadMeshPalette(DrawInstance* instance, const MeshNodeData* meshes, unsigned int count, bool compact, bool lod);
+        void uploadMeshIndices(DrawInstance* instance, const MeshNodeData& mesh);
+        void uploadMeshBuffers(DrawInstance* instance, const MeshNodeData* meshes, unsigned int count, bool compact);
+        void createMeshBuffers(DrawInstance* instance, SharedMeshBuffers& buffers, const MeshNodeData* meshes, unsigned int count, bool compact);
+        void acquireMeshBuffers(DrawInstance* instance, const MeshNodeData* meshes, unsigned int count, bool compact);
+        void releaseMeshBuffers(DrawInstance* instance);
+        void releaseSharedMeshBuffers(SharedMeshBuffers* buffers);
+        void prefetchMeshBuffers(DrawInstance* instance, const MeshPrefetchList* list, bool compact);
+        void drawPostProcess();
+
         void updateFramebufferTextures();
         void updateCameraPerspective();
         // void updateFogParticlesMotifSize();
@@ -63,6 +220,15 @@ namespace RasterRenderer
         {
             GLuint projectionMatrix;
             GLuint viewMatrix;
+            GLuint instanceOrigin;
+            GLuint instanceExtent;
+            GLuint motifSize;
+            GLuint motifTiles;
+            GLuint motifSpan;
+            GLuint meshCount;
+            GLuint meshOrigin;
+            GLuint meshExtent;
+            GLuint meshCompact;
 
             GLuint fog_projectionMatrix;
             GLuint fog_viewMatrix;
@@ -101,7 +267,19 @@ namespace RasterRenderer
         Renderer::ScreenRenderData* _screen_render_data;
         Renderer::Camera* camera;
 
+        // One instance per render node, in node creation order
         std::vector<DrawInstance*> instances;
+        std::vector<DrawInstance*> _drawOrder;
+        DrawInstance* _defaultInstance;
+        std::vector<unsigned int> _tilesScratch;
+        std::vector<unsigned int> _instancesScratch;
+        std::vector<unsigned char> _gatherScratch;
+        std::vector<uint32_t> _meshKeysScratch;
+        std::vector<DrawElementsIndirectCommand> _commandsScratch;
+        std::vector<uint8_t> _indicesScratch;
+        std::vector<uint8_t> _verticesScratch;
+        std::map<SharedMeshKey, SharedMeshBuffers> _sharedMeshes;
+
         inline void addInstance(DrawInstance* instance)
         {
             instances.push_back(instance);
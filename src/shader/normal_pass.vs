@@ -1,32 +1,80 @@
 #version 450
 const uint maxMeshMerge = 2;
 
-layout (location =  0) in vec3 posA;
+layout (location =  0) in vec3 posA; // Normalized [0, 1] when compact
 layout (location =  1) in vec3 posB;
-layout (location =  2) in vec3 nrmA;
+layout (location =  2) in vec3 nrmA; // Octahedral (xy) when compact
 layout (location =  3) in vec3 nrmB;
 
-layout (location =  4) in vec4 instancePos;
+layout (location =  4) in vec3 instancePos; // Normalized [0, 1] when quantized
 layout (location =  5) in vec4 instanceColor;
-layout (location =  6) in mat4 instanceRotMatrix;
-layout (location = 10) in mat4 motifPosMatrix;
+layout (location =  6) in vec3 instanceRot; // Euler angles (pitch, yaw, roll)
 
 
 uniform mat4 projectionMatrix;
 uniform mat4 viewMatrix;
 uniform uint meshCount = 1;
 
+// Quantized positions bounds (origin 0 and extent 1 for float positions)
+uniform vec3 instanceOrigin = vec3(0.0);
+uniform vec3 instanceExtent = vec3(1.0);
+
+// Compact mesh vertices bounds (origin 0 and extent 1 for float vertices)
+uniform vec3 meshOrigin = vec3(0.0);
+uniform vec3 meshExtent = vec3(1.0);
+uniform bool meshCompact = false;
+
+// Motif repetition: every instance is drawn once per visible tile of the [-motifTiles, motifTiles] grid
+uniform vec3  motifSize = vec3(0.0);
+uniform uvec3 motifTiles = uvec3(0);
+uniform uint  motifSpan = 1;
+
+// Indices of the tiles that survived culling
+layout (std430, binding = 0) readonly buffer MotifVisibleTiles
+{
+    uint motifVisibleTiles[];
+};
+
 layout (location = 99) uniform float meshParam = 0.0;
 
 out vec4 iColorOut;
 out vec3 normal;
 
+// Same as glm::eulerAngleYXZ(r.y, r.x, r.z)
+mat3 eulerAngleYXZ(vec3 r)
+{
+    vec3 c = cos(r);
+    vec3 s = sin(r);
+    mat3 ry = mat3(c.y, 0.0, -s.y,  0.0, 1.0, 0.0,  s.y, 0.0, c.y);
+    mat3 rx = mat3(1.0, 0.0, 0.0,  0.0, c.x, s.x,  0.0, -s.x, c.x);
+    mat3 rz = mat3(c.z, s.z, 0.0,  -s.z, c.z, 0.0,  0.0, 0.0, 1.0);
+    return ry * rx * rz;
+}
+
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if(n.z < 0.0)
+    {
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(n);
+}
+
+vec3 motifOffset()
+{
+    uvec3 n = 2u * motifTiles + 1u;
+    uint tile = motifVisibleTiles[uint(gl_InstanceID) % motifSpan];
+    uvec3 t = uvec3(tile % n.x, (tile / n.x) % n.y, tile / (n.x * n.y));
+    return (vec3(t) - vec3(motifTiles)) * motifSize;
+}
+
 void main()
 {
     iColorOut = instanceColor;
 
     // Calculate interpolated position and normal
-    vec3 nrm = nrmA;
+    vec3 nrm = meshCompact ? octDecode(nrmA.xy) : nrmA;
     vec3 pos = posA;
     if(meshCount > 1)
     {
@@ -34,9 +82,11 @@ void main()
         pos += posB * meshParam;
 
         nrm *= (1.0 - meshParam);
-        nrm += nrmB * meshParam;
+        nrm += (meshCompact ? octDecode(nrmB.xy) : nrmB) * meshParam;
     }
+    pos = meshOrigin + pos * meshExtent;
 
     normal = nrm;
-    gl_Position = projectionMatrix * viewMatrix * motifPosMatrix * (instancePos + (instanceRotMatrix * vec4(pos, 1.0)));
+    vec3 worldPos = instanceOrigin + instancePos * instanceExtent + eulerAngleYXZ(instanceRot) * pos;
+    gl_Position = projectionMatrix * viewMatrix * vec4(worldPos + motifOffset(), 1.0);
 }
@@ -0,0 +1,95 @@
+#include "mapped_file.h"
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "../log/logger.h"
+
+#ifdef _WIN32
+Utils::MappedFile::MappedFile(const std::string& filename)
+{
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(file == INVALID_HANDLE_VALUE)
+    {
+        L_ERROR("Failed to open file: %s", filename.c_str());
+        return;
+    }
+    _file = file;
+    _opened = true;
+
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(file, &size))
+    {
+        L_ERROR("Failed to get the file size: %s", filename.c_str());
+        _opened = false;
+        return;
+    }
+    _size = (size_t)size.QuadPart;
+
+    // Empty files cannot be mapped
+    if(_size == 0) return;
+
+    _mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(_mapping == nullptr)
+    {
+        L_ERROR("Failed to map file: %s", filename.c_str());
+        return;
+    }
+
+    _data = (const char*)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+    if(_data == nullptr)
+    {
+        L_ERROR("Failed to map file: %s", filename.c_str());
+    }
+}
+
+Utils::MappedFile::~MappedFile()
+{
+    if(_data != nullptr) UnmapViewOfFile(_data);
+    if(_mapping != nullptr) CloseHandle(_mapping);
+    if(_file != nullptr) CloseHandle(_file);
+}
+#else
+Utils::MappedFile::MappedFile(const std::string& filename)
+{
+    _fd = open(filename.c_str(), O_RDONLY);
+    if(_fd < 0)
+    {
+        L_ERROR("Failed to open file: %s", filename.c_str());
+        return;
+    }
+    _opened = true;
+
+    struct stat st;
+    if(fstat(_fd, &st) != 0)
+    {
+        L_ERROR("Failed to get the file size: %s", filename.c_str());
+        _opened = false;
+        return;
+    }
+    _size = (size_t)st.st_size;
+
+    // Empty files cannot be mapped
+    if(_size == 0) return;
+
+    void* data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+    if(data == MAP_FAILED)
+    {
+        L_ERROR("Failed to map file: %s", filename.c_str());
+        return;
+    }
+    madvise(data, _size, MADV_SEQUENTIAL);
+    _data = (const char*)data;
+}
+
+Utils::MappedFile::~MappedFile()
+{
+    if(_data != nullptr) munmap((void*)_data, _size);
+    if(_fd >= 0) close(_fd);
+}
+#endif
@@ -0,0 +1,43 @@
+#pragma once
+#include <string>
+#include <cstddef>
+
+namespace Utils
+{
+    // Read only memory mapping of a whole file
+    struct MappedFile
+    {
+        MappedFile(const std::string& filename);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        inline bool valid() const
+        {
+            return _data != nullptr || (_opened && _size == 0);
+        }
+
+        inline const char* data() const
+        {
+            return _data;
+        }
+
+        inline size_t size() const
+        {
+            return _size;
+        }
+
+    private:
+        const char* _data = nullptr;
+        size_t      _size = 0;
+        bool        _opened = false;
+
+#ifdef _WIN32
+        void* _file = nullptr;
+        void* _mapping = nullptr;
+#else
+        int _fd = -1;
+#endif
+    };
+}
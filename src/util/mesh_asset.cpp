@@ -0,0 +1,121 @@
+#include "mesh_asset.h"
+#include "../render/node_outputs.h"
+#include "../log/logger.h"
+
+#include <filesystem>
+#include <thread>
+
+template<typename T>
+static inline bool IsReady(const std::shared_future<T>& f)
+{
+    return f.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+Utils::MeshAsset::MeshAsset(const std::string& path, uint64_t id, bool buildLods) : path(path), id(id), lod_chain(buildLods)
+{
+    _mesh = std::async(std::launch::async, [path, buildLods]() {
+        CachedMeshData data = LoadMeshCached(path);
+
+        // Without lods the cache is written right away
+        if(!buildLods && !data.cached && !data.mesh.empty())
+        {
+            WriteMeshCache(path, data.source, data.mesh, nullptr);
+        }
+        return data;
+    }).share();
+
+    if(!buildLods) return;
+
+    // Waits for the mesh, then simplifies it and writes the cache (so the next load skips both)
+    _lods = std::async(std::launch::async, [mesh = _mesh, path]() {
+        const CachedMeshData& data = mesh.get();
+        if(data.has_lods || data.mesh.empty()) return IndexedLodChain();
+
+        IndexedLodChain chain = BuildLodChain(data.mesh, MESH_MAX_LODS);
+        WriteMeshCache(path, data.source, data.mesh, &chain);
+        return chain;
+    }).share();
+}
+
+Utils::MeshAsset::~MeshAsset()
+{
+    // Loads still running finish on their own instead of blocking the releasing thread
+    if(!IsReady(_mesh) || (_lods.valid() && !IsReady(_lods)))
+    {
+        std::thread([mesh = std::move(_mesh), lods = std::move(_lods)]() {
+            mesh.wait();
+            if(lods.valid()) lods.wait();
+        }).detach();
+    }
+}
+
+const Utils::CachedMeshData* Utils::MeshAsset::mesh() const
+{
+    return IsReady(_mesh) ? &_mesh.get() : nullptr;
+}
+
+const Utils::IndexedLodChain* Utils::MeshAsset::lods() const
+{
+    const CachedMeshData* data = mesh();
+    if(data == nullptr) return nullptr;
+    if(data->has_lods || !lod_chain) return &data->lods;
+    return IsReady(_lods) ? &_lods.get() : nullptr;
+}
+
+bool Utils::MeshAsset::view(MeshNodeData* out) const
+{
+    const CachedMeshData* data = mesh();
+    if(data == nullptr) return false;
+
+    *out = MeshNodeData();
+    out->vertex_data = data->mesh.vertices.data();
+    out->data_size = data->mesh.vertices.size();
+    out->index_data = data->mesh.indices.data();
+    out->index_count = data->mesh.index_count;
+    out->index_size = data->mesh.index_size;
+    out->asset_id = id;
+
+    const IndexedLodChain* chain = lods();
+    if(chain != nullptr && !chain->count.empty())
+    {
+        out->lod_index_data = chain->indices.data();
+        out->lod_count = (unsigned int)std::min<size_t>(chain->count.size(), MESH_MAX_LODS);
+        for(unsigned int i = 0; i < out->lod_count; i++)
+        {
+            out->lods[i] = { chain->first[i], chain->count[i], chain->error[i] };
+        }
+    }
+    return true;
+}
+
+std::shared_ptr<const Utils::MeshAsset> Utils::MeshAssetManager::Acquire(const std::string& filename, bool buildLods)
+{
+    std::error_code ec;
+    std::filesystem::path canonical = std::filesystem::weakly_canonical(filename, ec);
+    const std::string path = ec ? filename : canonical.string();
+
+    MeshAssetManager& instance = Instance();
+    std::lock_guard<std::mutex> lock(instance._lock);
+
+    // An asset with lods serves both kinds of users
+    for(bool lods : { true, false })
+    {
+        if(!lods && buildLods) break;
+
+        auto it = instance._assets.find({ path, lods });
+        if(it == instance._assets.end()) continue;
+
+        if(auto asset = it->second.lock())
+        {
+            L_DEBUG("Sharing mesh asset %s.", path.c_str());
+            return asset;
+        }
+    }
+
+    // Forget the released assets
+    std::erase_if(instance._assets, [](const auto& entry) { return entry.second.expired(); });
+
+    auto asset = std::make_shared<const MeshAsset>(path, instance._nextId++, buildLods);
+    instance._assets[{ path, buildLods }] = asset;
+    return asset;
+}
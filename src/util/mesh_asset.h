@@ -0,0 +1,56 @@
+#pragma once
+#include <memory>
+#include <future>
+#include <mutex>
+#include <map>
+#include "mesh_cache.h"
+
+struct MeshNodeData;
+
+namespace Utils
+{
+    // A mesh file loaded once and shared by every node using the same path
+    // The lod chain is built in the background once the mesh is loaded (cached meshes already have it)
+    struct MeshAsset
+    {
+        MeshAsset(const std::string& path, uint64_t id, bool buildLods);
+        ~MeshAsset();
+
+        MeshAsset(const MeshAsset&) = delete;
+        MeshAsset& operator=(const MeshAsset&) = delete;
+
+        // nullptr while loading, the mesh is empty if the load failed
+        const CachedMeshData* mesh() const;
+        const IndexedLodChain* lods() const;
+
+        // Points out at the asset data (valid for as long as the asset is held), false while loading
+        bool view(MeshNodeData* out) const;
+
+        const std::string path; // Canonical
+        const uint64_t    id;   // Never reused
+        const bool        lod_chain; // Assets without it report an empty chain
+
+    private:
+        std::shared_future<CachedMeshData>  _mesh;
+        std::shared_future<IndexedLodChain> _lods;
+    };
+
+    // Deduplicates mesh loads by canonical path, assets are freed when their last holder releases them
+    class MeshAssetManager
+    {
+    public:
+        static MeshAssetManager& Instance()
+        {
+            static MeshAssetManager _manager;
+            return _manager;
+        }
+
+        // Assets loaded without lods (e.g. sequence frames) are never handed out to users that want them
+        static std::shared_ptr<const MeshAsset> Acquire(const std::string& filename, bool buildLods = true);
+
+    private:
+        std::mutex _lock;
+        std::map<std::pair<std::string, bool>, std::weak_ptr<const MeshAsset>> _assets;
+        uint64_t _nextId = 1;
+    };
+}
@@ -0,0 +1,359 @@
+#include "mesh_cache.h"
+#include "mapped_file.h"
+#include "parallel.inl"
+
+#include "../log/logger.h"
+
+#include <filesystem>
+#include <algorithm>
+#include <thread>
+#include <cstring>
+#include <cstdio>
+
+// Cache files live here (relative to the working directory), named after a hash of the source path
+#define MESH_CACHE_DIRECTORY "cache/meshes/"
+
+// Bump whenever the layout or the loader output changes
+constexpr uint32_t MESH_CACHE_VERSION = 1;
+
+// Sections are aligned so the mapped arrays can be read in place
+constexpr uint64_t MESH_CACHE_ALIGNMENT = 16;
+
+// Sources are hashed in blocks of this size (in parallel), the block hashes are then combined in order
+constexpr size_t MESH_HASH_BLOCK_BYTES = 1 << 16;
+
+static const char MESH_CACHE_MAGIC[8] = { 'N', 'R', 'M', 'E', 'S', 'H', '\0', '\0' };
+
+enum MeshCacheFlags : uint32_t
+{
+    MESH_CACHE_HAS_LODS = 1 << 0
+};
+
+// Layout: header | source path | lods | vertices | indices | lod indices
+struct MeshCacheHeader
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t file_size;
+    uint64_t source_size;
+    int64_t  source_mtime;
+    uint64_t source_hash;
+    uint64_t path_size;
+    uint64_t vertex_count;     // 6 floats each
+    uint64_t index_count;
+    uint32_t index_size;
+    uint32_t lod_count;
+    uint64_t lod_offset;       // MeshCacheLod records
+    uint64_t vertex_offset;
+    uint64_t index_offset;
+    uint64_t lod_index_offset;
+    uint64_t lod_index_size;   // In bytes
+};
+
+struct MeshCacheLod
+{
+    uint64_t first;
+    uint64_t count;
+    float    error;
+    uint32_t pad;
+};
+
+static inline uint64_t AlignCacheOffset(uint64_t offset)
+{
+    return (offset + MESH_CACHE_ALIGNMENT - 1) / MESH_CACHE_ALIGNMENT * MESH_CACHE_ALIGNMENT;
+}
+
+static inline uint64_t MixHash(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+static uint64_t HashBytes(const char* data, size_t size, uint64_t seed)
+{
+    uint64_t h = seed ^ (size * 0x9e3779b97f4a7c15ull);
+    size_t i = 0;
+    for(; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t w;
+        memcpy(&w, data + i, sizeof(w));
+        h = (h ^ (w * 0x87c37b91114253d5ull)) * 0x4cf5ad432745937full;
+        h = (h << 31) | (h >> 33);
+    }
+
+    uint64_t tail = 0;
+    memcpy(&tail, data + i, size - i);
+    h ^= tail * 0x87c37b91114253d5ull;
+    return MixHash(h);
+}
+
+static uint64_t HashContents(const char* data, size_t size)
+{
+    const size_t blocks = (size + MESH_HASH_BLOCK_BYTES - 1) / MESH_HASH_BLOCK_BYTES;
+    std::vector<uint64_t> blockHashes(blocks);
+
+    // Fixed size blocks, so the hash does not depend on the thread count
+    Utils::ParallelFor(blocks, 64, [&](size_t b, size_t e) {
+        for(size_t i = b; i < e; i++)
+        {
+            const size_t offset = i * MESH_HASH_BLOCK_BYTES;
+            blockHashes[i] = HashBytes(data + offset, std::min(MESH_HASH_BLOCK_BYTES, size - offset), i);
+        }
+    });
+
+    return HashBytes((const char*)blockHashes.data(), blockHashes.size() * sizeof(uint64_t), size);
+}
+
+static std::string MeshSourcePath(const std::string& filename)
+{
+    std::error_code ec;
+    std::filesystem::path path = std::filesystem::absolute(filename, ec);
+    return (ec ? std::filesystem::path(filename) : path).lexically_normal().string();
+}
+
+static std::string MeshCachePath(const std::string& source)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.nrmesh", (unsigned long long)HashBytes(source.data(), source.size(), 0));
+    return MESH_CACHE_DIRECTORY + std::string(name);
+}
+
+static bool GetMeshSourceStamp(const std::string& filename, Utils::MeshSourceStamp* stamp)
+{
+    std::error_code ec;
+    auto mtime = std::filesystem::last_write_time(filename, ec);
+    if(ec) return false;
+
+    Utils::MappedFile file(filename);
+    if(!file.valid()) return false;
+
+    stamp->size = file.size();
+    stamp->mtime = (int64_t)mtime.time_since_epoch().count();
+    stamp->hash = HashContents(file.data(), file.size());
+    return true;
+}
+
+// Every index must name a stored vertex (checked on the copy, the mapped file may not be aligned)
+static bool IndicesInRange(const uint8_t* indices, size_t count, uint32_t indexSize, uint64_t vertexCount)
+{
+    uint32_t maxIndex = 0;
+    for(size_t i = 0; i < count; i++)
+    {
+        const uint32_t index = indexSize == sizeof(uint16_t) ? ((const uint16_t*)indices)[i] : ((const uint32_t*)indices)[i];
+        maxIndex = std::max(maxIndex, index);
+    }
+    return count == 0 || maxIndex < vertexCount;
+}
+
+static bool ReadMeshCache(const std::string& cache, const std::string& source, const Utils::MeshSourceStamp& stamp, Utils::CachedMeshData* out)
+{
+    std::error_code ec;
+    if(!std::filesystem::is_regular_file(cache, ec)) return false;
+
+    Utils::MappedFile file(cache);
+    if(!file.valid() || file.size() < sizeof(MeshCacheHeader)) return false;
+
+    MeshCacheHeader header;
+    memcpy(&header, file.data(), sizeof(header));
+
+    if(memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic)) != 0 || header.version != MESH_CACHE_VERSION)
+    {
+        return false;
+    }
+
+    if(header.file_size != file.size()
+    || header.path_size != source.size()
+    || sizeof(header) + source.size() > file.size()
+    || memcmp(file.data() + sizeof(header), source.data(), source.size()) != 0)
+    {
+        return false;
+    }
+
+    if(!(Utils::MeshSourceStamp{ header.source_size, header.source_mtime, header.source_hash } == stamp))
+    {
+        L_DEBUG("Mesh cache of %s is stale.", source.c_str());
+        return false;
+    }
+
+    // Untrusted from here on, every section must lie inside the file
+    if((header.index_size != sizeof(uint16_t) && header.index_size != sizeof(uint32_t))
+    || header.index_count == 0
+    || header.index_count > file.size() / header.index_size
+    || header.vertex_count > file.size() / (6 * sizeof(float))
+    || header.lod_count > 32
+    || header.lod_index_size > file.size())
+    {
+        L_ERROR("Mesh cache of %s is corrupted.", source.c_str());
+        return false;
+    }
+
+    const uint64_t vertexBytes = header.vertex_count * 6 * sizeof(float);
+    const uint64_t indexBytes = header.index_count * header.index_size;
+    if(header.lod_offset > file.size()
+    || header.vertex_offset > file.size()
+    || header.index_offset > file.size()
+    || header.lod_index_offset > file.size()
+    || header.lod_offset + header.lod_count * sizeof(MeshCacheLod) > file.size()
+    || header.vertex_offset + vertexBytes > file.size()
+    || header.index_offset + indexBytes > file.size()
+    || header.lod_index_offset + header.lod_index_size > file.size())
+    {
+        L_ERROR("Mesh cache of %s is corrupted.", source.c_str());
+        return false;
+    }
+
+    Utils::IndexedVertexData& mesh = out->mesh;
+    mesh.vertices.resize(header.vertex_count * 6);
+    memcpy(mesh.vertices.data(), file.data() + header.vertex_offset, vertexBytes);
+    mesh.indices.resize(indexBytes);
+    memcpy(mesh.indices.data(), file.data() + header.index_offset, indexBytes);
+    mesh.index_count = header.index_count;
+    mesh.index_size = header.index_size;
+
+    Utils::IndexedLodChain& lods = out->lods;
+    lods.indices.resize(header.lod_index_size);
+    memcpy(lods.indices.data(), file.data() + header.lod_index_offset, header.lod_index_size);
+
+    if(!IndicesInRange(mesh.indices.data(), mesh.index_count, header.index_size, header.vertex_count)
+    || !IndicesInRange(lods.indices.data(), lods.indices.size() / header.index_size, header.index_size, header.vertex_count))
+    {
+        L_ERROR("Mesh cache of %s is corrupted.", source.c_str());
+        out->mesh = Utils::IndexedVertexData();
+        out->lods = Utils::IndexedLodChain();
+        return false;
+    }
+    for(uint32_t i = 0; i < header.lod_count; i++)
+    {
+        MeshCacheLod lod;
+        memcpy(&lod, file.data() + header.lod_offset + i * sizeof(MeshCacheLod), sizeof(lod));
+        if(lod.first > header.lod_index_size || lod.count > header.lod_index_size || (lod.first + lod.count) * header.index_size > header.lod_index_size)
+        {
+            L_ERROR("Mesh cache of %s is corrupted.", source.c_str());
+            out->mesh = Utils::IndexedVertexData();
+            out->lods = Utils::IndexedLodChain();
+            return false;
+        }
+        lods.first.push_back(lod.first);
+        lods.count.push_back(lod.count);
+        lods.error.push_back(lod.error);
+    }
+
+    out->has_lods = (header.flags & MESH_CACHE_HAS_LODS) != 0;
+    out->cached = true;
+    return true;
+}
+
+Utils::CachedMeshData Utils::LoadMeshCached(const std::string& filename)
+{
+    CachedMeshData data;
+    if(!GetMeshSourceStamp(filename, &data.source))
+    {
+        L_ERROR("Failed to read mesh source: %s", filename.c_str());
+        return data;
+    }
+
+    const std::string source = MeshSourcePath(filename);
+    if(ReadMeshCache(MeshCachePath(source), source, data.source, &data))
+    {
+        L_DEBUG("Loaded %s from the mesh cache.", filename.c_str());
+        return data;
+    }
+
+    data.mesh = LoadIndexedVertexDataFromFile(filename);
+    return data;
+}
+
+bool Utils::WriteMeshCache(const std::string& filename, const MeshSourceStamp& stamp, const IndexedVertexData& mesh, const IndexedLodChain* chain)
+{
+    if(mesh.empty()) return false;
+
+    static const IndexedLodChain none;
+    const IndexedLodChain& lods = chain != nullptr ? *chain : none;
+
+    const std::string source = MeshSourcePath(filename);
+    const std::string cache = MeshCachePath(source);
+
+    std::error_code ec;
+    std::filesystem::create_directories(MESH_CACHE_DIRECTORY, ec);
+    if(ec)
+    {
+        L_ERROR("Failed to create the mesh cache directory: %s", ec.message().c_str());
+        return false;
+    }
+
+    MeshCacheHeader header = {};
+    memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+    header.version = MESH_CACHE_VERSION;
+    header.flags = chain != nullptr ? (uint32_t)MESH_CACHE_HAS_LODS : 0u;
+    header.source_size = stamp.size;
+    header.source_mtime = stamp.mtime;
+    header.source_hash = stamp.hash;
+    header.path_size = source.size();
+    header.vertex_count = mesh.vertices.size() / 6;
+    header.index_count = mesh.index_count;
+    header.index_size = mesh.index_size;
+    header.lod_count = (uint32_t)lods.count.size();
+    header.lod_offset = AlignCacheOffset(sizeof(header) + source.size());
+    header.vertex_offset = AlignCacheOffset(header.lod_offset + header.lod_count * sizeof(MeshCacheLod));
+    header.index_offset = AlignCacheOffset(header.vertex_offset + mesh.vertices.size() * sizeof(float));
+    header.lod_index_offset = AlignCacheOffset(header.index_offset + mesh.indices.size());
+    header.lod_index_size = lods.indices.size();
+    header.file_size = header.lod_index_offset + header.lod_index_size;
+
+    // Written aside and renamed over, readers never see a partial file
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%zx.tmp", std::hash<std::thread::id>()(std::this_thread::get_id()));
+    const std::string temp = cache + suffix;
+
+    FILE* f = fopen(temp.c_str(), "wb");
+    if(f == nullptr)
+    {
+        L_ERROR("Failed to write mesh cache: %s", temp.c_str());
+        return false;
+    }
+
+    const char zeros[MESH_CACHE_ALIGNMENT] = {};
+    uint64_t written = 0;
+    auto write = [&](const void* data, uint64_t size) {
+        if(size > 0) written += fwrite(data, 1, size, f);
+    };
+    auto pad = [&](uint64_t offset) {
+        if(offset > written && offset - written <= sizeof(zeros)) write(zeros, offset - written);
+    };
+
+    write(&header, sizeof(header));
+    write(source.data(), source.size());
+    pad(header.lod_offset);
+    for(size_t i = 0; i < lods.count.size(); i++)
+    {
+        MeshCacheLod lod = { lods.first[i], lods.count[i], lods.error[i], 0 };
+        write(&lod, sizeof(lod));
+    }
+    pad(header.vertex_offset);
+    write(mesh.vertices.data(), mesh.vertices.size() * sizeof(float));
+    pad(header.index_offset);
+    write(mesh.indices.data(), mesh.indices.size());
+    pad(header.lod_index_offset);
+    write(lods.indices.data(), lods.indices.size());
+
+    const bool ok = fclose(f) == 0 && written == header.file_size;
+    if(ok)
+    {
+        std::filesystem::rename(temp, cache, ec);
+    }
+
+    if(!ok || ec)
+    {
+        L_ERROR("Failed to write mesh cache: %s", cache.c_str());
+        std::filesystem::remove(temp, ec);
+        return false;
+    }
+
+    L_DEBUG("Wrote mesh cache of %s (%llu bytes).", filename.c_str(), (unsigned long long)header.file_size);
+    return true;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include "objloader.h"
+#include "simplify.h"
+
+namespace Utils
+{
+    // Identifies the exact source file a cache entry was built from
+    struct MeshSourceStamp
+    {
+        uint64_t size = 0;
+        int64_t  mtime = 0;
+        uint64_t hash = 0; // Content hash
+
+        inline bool operator==(const MeshSourceStamp& rhs) const
+        {
+            return size == rhs.size && mtime == rhs.mtime && hash == rhs.hash;
+        }
+    };
+
+    struct CachedMeshData
+    {
+        IndexedVertexData mesh;
+        IndexedLodChain   lods;
+        MeshSourceStamp   source;
+        bool              cached = false;   // Read from the cache instead of the source
+        bool              has_lods = false; // The lod chain was already built (it might still have no levels)
+    };
+
+    // Loads a mesh from its binary cache when it matches the source path, size, mtime and contents
+    // Otherwise parses the source, the caller writes the cache back once the lods are built
+    CachedMeshData LoadMeshCached(const std::string& filename);
+
+    // Writes (or replaces) the cache of filename, stamp is the source state the data was built from
+    // chain is nullptr when the lods were not built (the next load builds them)
+    bool WriteMeshCache(const std::string& filename, const MeshSourceStamp& stamp, const IndexedVertexData& mesh, const IndexedLodChain* chain);
+}
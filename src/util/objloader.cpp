@@ -1,73 +1,401 @@
-#define TINYOBJLOADER_IMPLEMENTATION
 #include "objloader.h"
-
-#include "../../tinyobjloader/tiny_obj_loader.h"
+#include "mapped_file.h"
+#include "parallel.inl"
 
 #include "../log/logger.h"
 
-std::vector<float> Utils::LoadFloatVertexDataFromFile(const std::string& filename)
+#include <unordered_map>
+#include <charconv>
+#include <cstring>
+
+// Files are split into line aligned chunks of at least this many bytes, parsed in parallel
+constexpr size_t OBJ_MIN_CHUNK_BYTES = 1 << 20;
+
+// Below this many triangle corners per thread the corner passes run single threaded
+constexpr size_t OBJ_MIN_CORNERS_PER_THREAD = 1 << 16;
+
+enum ObjError
+{
+    OBJ_ERROR_NONE       = 0,
+    OBJ_ERROR_NO_NORMALS = 1 << 0,
+    OBJ_ERROR_BAD_NUMBER = 1 << 1,
+    OBJ_ERROR_BAD_INDEX  = 1 << 2
+};
+
+// Lines starting in [begin, end), counted first and then parsed straight into the final arrays
+struct ObjChunk
+{
+    const char* begin = nullptr;
+    const char* end = nullptr;
+
+    size_t positions = 0; // v lines
+    size_t normals = 0;   // vn lines
+    size_t corners = 0;   // Triangle corners (faces are fan triangulated)
+
+    size_t positionBase = 0;
+    size_t normalBase = 0;
+    size_t cornerBase = 0;
+
+    int error = OBJ_ERROR_NONE;
+};
+
+enum ObjKeyword
+{
+    OBJ_OTHER,
+    OBJ_POSITION,
+    OBJ_NORMAL,
+    OBJ_FACE
+};
+
+static inline bool IsBlank(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+static inline const char* SkipBlanks(const char* p, const char* end)
+{
+    while(p < end && IsBlank(*p)) p++;
+    return p;
+}
+
+// End of the line starting at p (without the line break)
+static inline const char* LineEnd(const char* p, const char* end, const char** next)
+{
+    const char* e = (const char*)memchr(p, '\n', end - p);
+    *next = e ? e + 1 : end;
+    if(!e) e = end;
+    if(e > p && e[-1] == '\r') e--;
+    return e;
+}
+
+static inline ObjKeyword ParseKeyword(const char** p, const char* end)
 {
-    tinyobj::ObjReaderConfig reader_config;
-    tinyobj::ObjReader reader;
+    const char* s = *p;
+    if(end - s >= 2 && s[0] == 'v' && IsBlank(s[1]))                 { *p += 2; return OBJ_POSITION; }
+    if(end - s >= 3 && s[0] == 'v' && s[1] == 'n' && IsBlank(s[2])) { *p += 3; return OBJ_NORMAL; }
+    if(end - s >= 2 && s[0] == 'f' && IsBlank(s[1]))                 { *p += 2; return OBJ_FACE; }
+    return OBJ_OTHER;
+}
 
-    if (!reader.ParseFromFile(filename, reader_config))
+static inline bool ParseFloats3(const char* p, const char* end, float* out)
+{
+    for(int c = 0; c < 3; c++)
     {
-        if (!reader.Error().empty()) 
-        {
-            L_ERROR("TinyObjReader: %s", reader.Error().c_str());
-        }
+        p = SkipBlanks(p, end);
+        if(p < end && *p == '+') p++;
+        auto r = std::from_chars(p, end, out[c]);
+        if(r.ec != std::errc()) return false;
+        p = r.ptr;
     }
+    return true;
+}
 
-    if (!reader.Warning().empty()) 
+// Vertices of a face line (blank separated tokens, up to a comment)
+static inline size_t CountFaceVertices(const char* p, const char* end)
+{
+    size_t count = 0;
+    while(true)
     {
-        L_ERROR("TinyObjReader: %s", reader.Warning().c_str());
+        p = SkipBlanks(p, end);
+        if(p >= end || *p == '#') return count;
+        count++;
+        while(p < end && !IsBlank(*p)) p++;
     }
+}
 
-    auto& attrib = reader.GetAttrib();
-    auto& shapes = reader.GetShapes();
-
-    std::vector<float> data;
+// Zero based index from a one based (or negative, relative to current) obj index, -1 when invalid
+static inline int64_t ResolveIndex(int64_t index, size_t current, size_t total)
+{
+    const int64_t resolved = index > 0 ? index - 1 : (int64_t)current + index;
+    return (index != 0 && resolved >= 0 && resolved < (int64_t)total) ? resolved : -1;
+}
 
-    for (size_t s = 0; s < shapes.size(); s++)
+static void CountObjChunk(ObjChunk& chunk)
+{
+    const char* next;
+    for(const char* line = chunk.begin; line < chunk.end; line = next)
     {
-        size_t index_offset = 0;
-        for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++)
+        const char* end = LineEnd(line, chunk.end, &next);
+        const char* p = SkipBlanks(line, end);
+
+        switch(ParseKeyword(&p, end))
         {
-            size_t fv = size_t(shapes[s].mesh.num_face_vertices[f]);
-            data.reserve(data.capacity() + fv * 6); // NOTE: capacity() should be the same as size() here
-            for (size_t v = 0; v < fv; v++)
+            case OBJ_POSITION: chunk.positions++; break;
+            case OBJ_NORMAL:   chunk.normals++; break;
+            case OBJ_FACE:
             {
-                // Assuming triangles
-                tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
-                tinyobj::real_t vx = attrib.vertices[3*size_t(idx.vertex_index)+0];
-                tinyobj::real_t vy = attrib.vertices[3*size_t(idx.vertex_index)+1];
-                tinyobj::real_t vz = attrib.vertices[3*size_t(idx.vertex_index)+2];
+                const size_t n = CountFaceVertices(p, end);
+                if(n >= 3) chunk.corners += 3 * (n - 2);
+                break;
+            }
+            default: break;
+        }
+    }
+}
+
+static void ParseObjChunk(ObjChunk& chunk, size_t totalPositions, size_t totalNormals, float* positions, float* normals, uint32_t* cornerPositions, uint32_t* cornerNormals)
+{
+    size_t position = chunk.positionBase;
+    size_t normal = chunk.normalBase;
+    size_t corner = chunk.cornerBase;
+    std::vector<uint32_t> face;
+
+    const char* next;
+    for(const char* line = chunk.begin; line < chunk.end; line = next)
+    {
+        const char* end = LineEnd(line, chunk.end, &next);
+        const char* p = SkipBlanks(line, end);
 
-                if (idx.normal_index >= 0)
+        switch(ParseKeyword(&p, end))
+        {
+            case OBJ_POSITION:
+                if(!ParseFloats3(p, end, positions + 3 * position)) chunk.error |= OBJ_ERROR_BAD_NUMBER;
+                position++;
+                break;
+
+            case OBJ_NORMAL:
+                if(!ParseFloats3(p, end, normals + 3 * normal)) chunk.error |= OBJ_ERROR_BAD_NUMBER;
+                normal++;
+                break;
+
+            case OBJ_FACE:
+            {
+                // Tokens are v, v/vt, v//vn or v/vt/vn, stored as (position, normal) pairs
+                face.clear();
+                const size_t n = CountFaceVertices(p, end);
+                for(size_t i = 0; i < n; i++)
                 {
-                    tinyobj::real_t nx = attrib.normals[3*size_t(idx.normal_index)+0];
-                    tinyobj::real_t ny = attrib.normals[3*size_t(idx.normal_index)+1];
-                    tinyobj::real_t nz = attrib.normals[3*size_t(idx.normal_index)+2];
+                    p = SkipBlanks(p, end);
+                    int64_t v = 0, vn = 0;
+                    auto r = std::from_chars(p, end, v);
+                    p = r.ptr;
+                    if(p < end && *p == '/')
+                    {
+                        p++;
+                        if(p < end && *p != '/') p = std::from_chars(p, end, vn).ptr; // Texture coordinate, unused
+                        vn = 0;
+                        if(p < end && *p == '/')
+                        {
+                            p++;
+                            p = std::from_chars(p, end, vn).ptr;
+                        }
+                    }
+                    while(p < end && !IsBlank(*p)) p++;
 
-                    data.push_back(vx);
-                    data.push_back(vy);
-                    data.push_back(vz);
+                    if(vn == 0) chunk.error |= OBJ_ERROR_NO_NORMALS;
 
-                    data.push_back(nx);
-                    data.push_back(ny);
-                    data.push_back(nz);
+                    const int64_t rv = ResolveIndex(v, position, totalPositions);
+                    const int64_t rn = ResolveIndex(vn, normal, totalNormals);
+                    if(rv < 0 || rn < 0) chunk.error |= OBJ_ERROR_BAD_INDEX;
+
+                    face.push_back((uint32_t)std::max<int64_t>(rv, 0));
+                    face.push_back((uint32_t)std::max<int64_t>(rn, 0));
                 }
-                else
+
+                for(size_t i = 2; i < n; i++)
                 {
-                    // TODO: Compute some normals based on the triangles, for now, throw an error
-                    L_ERROR("Obj Reader requires an input with normal data.");
-                    return std::vector<float>();
+                    const size_t fan[3] = { 0, i - 1, i };
+                    for(size_t k : fan)
+                    {
+                        cornerPositions[corner] = face[2 * k];
+                        cornerNormals[corner] = face[2 * k + 1];
+                        corner++;
+                    }
                 }
+                break;
             }
-            index_offset += fv;
+            default: break;
+        }
+    }
+}
+
+// (position, normal) pair, compared by bit pattern
+struct VertexKey
+{
+    uint32_t bits[6];
+    uint64_t hash;
+
+    inline bool operator==(const VertexKey& rhs) const
+    {
+        return memcmp(bits, rhs.bits, sizeof(bits)) == 0;
+    }
+};
+
+struct VertexKeyHash
+{
+    inline size_t operator()(const VertexKey& k) const
+    {
+        return (size_t)k.hash;
+    }
+};
+
+static inline VertexKey MakeVertexKey(const float* position, const float* normal)
+{
+    VertexKey key;
+    memcpy(key.bits, position, 3 * sizeof(float));
+    memcpy(key.bits + 3, normal, 3 * sizeof(float));
+
+    // FNV-1a over the six words, then mixed so both the low and the high bits are usable
+    uint64_t h = 14695981039346656037ull;
+    for(uint32_t b : key.bits)
+    {
+        h = (h ^ b) * 1099511628211ull;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    key.hash = h;
+    return key;
+}
+
+// Corners are split across threads by the high hash bits, each thread deduplicating its own share
+static inline size_t VertexKeyShard(uint64_t hash, size_t shards)
+{
+    return (size_t)(hash >> 32) % shards;
+}
+
+Utils::IndexedVertexData Utils::LoadIndexedVertexDataFromFile(const std::string& filename)
+{
+    MappedFile file(filename);
+    if(!file.valid())
+    {
+        return IndexedVertexData();
+    }
+
+    // Chunks own the lines starting inside their byte range
+    const size_t size = file.size();
+    const char* data = file.data();
+    const size_t chunkCount = GetParallelChunkCount(size, OBJ_MIN_CHUNK_BYTES);
+    std::vector<ObjChunk> chunks(chunkCount);
+    const char* begin = data;
+    for(size_t c = 0; c < chunkCount; c++)
+    {
+        const char* end = (c + 1 == chunkCount) ? data + size : data + size * (c + 1) / chunkCount;
+        if(end < begin) end = begin;
+        while(end < data + size && end > data && end[-1] != '\n') end++;
+        chunks[c].begin = begin;
+        chunks[c].end = end;
+        begin = end;
+    }
+
+    ParallelTasks(chunkCount, [&](size_t c) { CountObjChunk(chunks[c]); });
+
+    size_t totalPositions = 0;
+    size_t totalNormals = 0;
+    size_t totalCorners = 0;
+    for(ObjChunk& chunk : chunks)
+    {
+        chunk.positionBase = totalPositions;
+        chunk.normalBase = totalNormals;
+        chunk.cornerBase = totalCorners;
+        totalPositions += chunk.positions;
+        totalNormals += chunk.normals;
+        totalCorners += chunk.corners;
+    }
+
+    if(totalCorners == 0)
+    {
+        L_ERROR("Obj Reader: No faces found in %s.", filename.c_str());
+        return IndexedVertexData();
+    }
+
+    std::vector<float> positions(totalPositions * 3);
+    std::vector<float> normals(totalNormals * 3);
+    std::vector<uint32_t> cornerPositions(totalCorners);
+    std::vector<uint32_t> cornerNormals(totalCorners);
+
+    ParallelTasks(chunkCount, [&](size_t c) {
+        ParseObjChunk(chunks[c], totalPositions, totalNormals, positions.data(), normals.data(), cornerPositions.data(), cornerNormals.data());
+    });
+
+    int error = OBJ_ERROR_NONE;
+    for(const ObjChunk& chunk : chunks) error |= chunk.error;
+    if(error & OBJ_ERROR_NO_NORMALS)
+    {
+        // TODO: Compute some normals based on the triangles, for now, throw an error
+        L_ERROR("Obj Reader requires an input with normal data.");
+        return IndexedVertexData();
+    }
+    if(error != OBJ_ERROR_NONE)
+    {
+        L_ERROR("Obj Reader: Malformed %s (invalid %s).", filename.c_str(), (error & OBJ_ERROR_BAD_INDEX) ? "face index" : "number");
+        return IndexedVertexData();
+    }
+
+    // Deduplicate (position, normal) pairs: every shard keeps the pairs of its hashes
+    std::vector<uint64_t> hashes(totalCorners);
+    ParallelFor(totalCorners, OBJ_MIN_CORNERS_PER_THREAD, [&](size_t b, size_t e) {
+        for(size_t i = b; i < e; i++)
+        {
+            hashes[i] = MakeVertexKey(&positions[3 * cornerPositions[i]], &normals[3 * cornerNormals[i]]).hash;
+        }
+    });
+
+    const size_t shards = GetParallelChunkCount(totalCorners, OBJ_MIN_CORNERS_PER_THREAD);
+    std::vector<uint32_t> shardIndex(totalCorners);
+    std::vector<std::vector<uint32_t>> shardCorners(shards); // First corner of every unique pair
+    ParallelTasks(shards, [&](size_t s) {
+        std::unordered_map<VertexKey, uint32_t, VertexKeyHash> unique;
+        unique.reserve(totalCorners / shards);
+        std::vector<uint32_t>& first = shardCorners[s];
+
+        for(size_t i = 0; i < totalCorners; i++)
+        {
+            if(VertexKeyShard(hashes[i], shards) != s) continue;
+
+            VertexKey key = MakeVertexKey(&positions[3 * cornerPositions[i]], &normals[3 * cornerNormals[i]]);
+            auto [it, inserted] = unique.try_emplace(key, (uint32_t)first.size());
+            if(inserted) first.push_back((uint32_t)i);
+            shardIndex[i] = it->second;
         }
+    });
+
+    std::vector<size_t> shardBase(shards + 1, 0);
+    for(size_t s = 0; s < shards; s++) shardBase[s + 1] = shardBase[s] + shardCorners[s].size();
+    const size_t vertexCount = shardBase[shards];
+
+    // Vertices are numbered in order of first use, as a sequential dedupe would
+    std::vector<uint32_t> order(vertexCount, UINT32_MAX);
+    std::vector<uint32_t> indices(totalCorners);
+    uint32_t next = 0;
+    for(size_t i = 0; i < totalCorners; i++)
+    {
+        const size_t unique = shardBase[VertexKeyShard(hashes[i], shards)] + shardIndex[i];
+        if(order[unique] == UINT32_MAX) order[unique] = next++;
+        indices[i] = order[unique];
     }
-    return data;
+
+    IndexedVertexData mesh;
+    mesh.vertices.resize(vertexCount * 6);
+    ParallelTasks(shards, [&](size_t s) {
+        for(size_t u = 0; u < shardCorners[s].size(); u++)
+        {
+            const uint32_t corner = shardCorners[s][u];
+            float* out = &mesh.vertices[6 * (size_t)order[shardBase[s] + u]];
+            memcpy(out, &positions[3 * cornerPositions[corner]], 3 * sizeof(float));
+            memcpy(out + 3, &normals[3 * cornerNormals[corner]], 3 * sizeof(float));
+        }
+    });
+
+    // 16 bit indices whenever every vertex is addressable with them
+    mesh.index_count = totalCorners;
+    mesh.index_size = vertexCount <= 65536 ? sizeof(uint16_t) : sizeof(uint32_t);
+    mesh.indices.resize(mesh.index_count * mesh.index_size);
+
+    if(mesh.index_size == sizeof(uint16_t))
+    {
+        uint16_t* out = (uint16_t*)mesh.indices.data();
+        ParallelFor(totalCorners, OBJ_MIN_CORNERS_PER_THREAD, [&](size_t b, size_t e) {
+            for(size_t i = b; i < e; i++) out[i] = (uint16_t)indices[i];
+        });
+    }
+    else
+    {
+        memcpy(mesh.indices.data(), indices.data(), indices.size() * sizeof(uint32_t));
+    }
+
+    L_DEBUG("Obj Reader: %zu triangle corners, %zu unique vertices (%zu chunks).", mesh.index_count, vertexCount, chunkCount);
+    return mesh;
 }
 
 void Utils::DumpObjFileToDiskFromData(const std::string& filename, const float* data, size_t count, bool hasNormals)
@@ -1,11 +1,27 @@
 #pragma once
 #include <vector>
 #include <string>
+#include <cstdint>
 #include "../math/vector.h"
 
 namespace Utils
 {
-    std::vector<float> LoadFloatVertexDataFromFile(const std::string& filename);
+    // Unique pos + normal vertices (6 floats each) and the triangle indices into them
+    struct IndexedVertexData
+    {
+        std::vector<float>   vertices;
+        std::vector<uint8_t> indices;         // Packed 16 or 32 bit indices
+        size_t               index_count = 0;
+        unsigned int         index_size = 0;  // Bytes per index
+
+        inline bool empty() const
+        {
+            return index_count == 0;
+        }
+    };
+
+    // Loads the triangles of an obj file, (position, normal) pairs shared by several corners are stored once
+    IndexedVertexData LoadIndexedVertexDataFromFile(const std::string& filename);
 
     void DumpObjFileToDiskFromData(const std::string& filename, const float* data, size_t count, bool hasNormals = false);
     void DumpObjFileToDiskFromData(const std::string& filename, const std::vector<Vector3>& data);
@@ -0,0 +1,96 @@
+#pragma once
+#include <thread>
+#include <future>
+#include <vector>
+#include <algorithm>
+
+namespace Utils
+{
+    // Element boundaries between chunks are kept at multiples of this
+    // This keeps SIMD loops aligned within each chunk and avoids false sharing on writes
+    constexpr size_t PARALLEL_CHUNK_ALIGNMENT = 64;
+
+    inline unsigned int GetWorkerCount()
+    {
+        static const unsigned int count = std::max(1u, std::thread::hardware_concurrency());
+        return count;
+    }
+
+    // How many chunks ParallelForChunks() will split count elements into
+    // Each chunk holds at least minChunkSize elements (except when count itself is smaller)
+    inline size_t GetParallelChunkCount(size_t count, size_t minChunkSize)
+    {
+        if(minChunkSize == 0) minChunkSize = 1;
+        size_t chunks = count / minChunkSize;
+        return std::clamp<size_t>(chunks, 1, GetWorkerCount());
+    }
+
+    // Returns the [begin, end) range of the chunk with index chunk
+    inline void GetParallelChunkRange(size_t count, size_t chunkCount, size_t chunk, size_t* begin, size_t* end)
+    {
+        size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+        chunkSize = ((chunkSize + PARALLEL_CHUNK_ALIGNMENT - 1) / PARALLEL_CHUNK_ALIGNMENT) * PARALLEL_CHUNK_ALIGNMENT;
+        *begin = std::min(count, chunk * chunkSize);
+        *end   = std::min(count, *begin + chunkSize);
+    }
+
+    // Runs func(chunk, begin, end) for chunkCount contiguous chunks of [0, count)
+    // The first chunk runs on the calling thread, this only returns after all the chunks are done
+    template<typename F>
+    inline void ParallelForChunks(size_t count, size_t chunkCount, F&& func)
+    {
+        if(chunkCount <= 1)
+        {
+            func((size_t)0, (size_t)0, count);
+            return;
+        }
+
+        std::vector<std::future<void>> workers;
+        workers.reserve(chunkCount - 1);
+        for(size_t c = 1; c < chunkCount; c++)
+        {
+            size_t begin, end;
+            GetParallelChunkRange(count, chunkCount, c, &begin, &end);
+            if(begin >= end) continue;
+            workers.push_back(std::async(std::launch::async, [&func, c, begin, end]() { func(c, begin, end); }));
+        }
+
+        size_t begin, end;
+        GetParallelChunkRange(count, chunkCount, 0, &begin, &end);
+        func((size_t)0, begin, end);
+
+        for(auto& w : workers)
+        {
+            w.get();
+        }
+    }
+
+    // Runs func(task) for every task in [0, taskCount), each on its own thread (the first one on the calling thread)
+    // For work that is already split in uneven pieces, ParallelForChunks() splits a range evenly instead
+    template<typename F>
+    inline void ParallelTasks(size_t taskCount, F&& func)
+    {
+        std::vector<std::future<void>> workers;
+        workers.reserve(taskCount > 0 ? taskCount - 1 : 0);
+        for(size_t t = 1; t < taskCount; t++)
+        {
+            workers.push_back(std::async(std::launch::async, [&func, t]() { func(t); }));
+        }
+
+        if(taskCount > 0) func((size_t)0);
+
+        for(auto& w : workers)
+        {
+            w.get();
+        }
+    }
+
+    // Runs func(begin, end) over [0, count), splitting it across threads if there is enough work
+    template<typename F>
+    inline void ParallelFor(size_t count, size_t minChunkSize, F&& func)
+    {
+        ParallelForChunks(count, GetParallelChunkCount(count, minChunkSize), [&func](size_t, size_t begin, size_t end) {
+            func(begin, end);
+        });
+    }
+}
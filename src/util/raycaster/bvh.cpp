@@ -1,11 +1,13 @@
 #include "bvh.h"
 #include "../../../glm/glm/glm.hpp"
 #include "../../../glm/glm/gtx/transform.hpp"
+#include <bit>
+#include <cmath>
+#include <limits>
 
 Utils::BvhTree::BvhTree(const float* vertices, size_t count, size_t stride, size_t offset, float sx, float sy, float sz)
 {
     using Vector3f = bvh::Vector3<float>;
-    std::vector<bvh::Triangle<float>> triangles;
 
     // Create triangles from parent vertices with certain offset / stride
     for(size_t i = offset; i < count; i += stride + 18)
@@ -37,13 +39,176 @@ Utils::BvhTree::BvhTree(const float* vertices, size_t count, size_t stride, size
     builder.build(global_bbox, bboxes.get(), centers.get(), triangles.size());
 
     primitive_intersector = new bvh::ClosestPrimitiveIntersector<BvhHandler, bvh::Triangle<float>>(bvhHandler, triangles.data());
-    traverser = new bvh::SingleRayTraverser<BvhHandler>(bvhHandler);
 }
 
 Utils::BvhTree::~BvhTree()
 {
     if(primitive_intersector)
         delete primitive_intersector;
-    if(traverser)
-        delete traverser;
+}
+
+void Utils::BvhTree::isectPacket(const Vector3& o, const Vector3* d, size_t count, std::optional<ISecResult>* hits, const float min_dist, const float max_dist) const
+{
+    using namespace Math::Simd;
+    constexpr size_t W = PACKET_SIZE;
+    constexpr size_t STACK_SIZE = 64; // Same depth as the single ray traverser
+
+    for(size_t i = 0; i < count; i++) hits[i] = std::nullopt;
+    if(bvhHandler.node_count == 0 || count == 0) return;
+
+    // Lanes past count repeat the first ray, their tmax is below tmin so they never hit anything
+    alignas(32) float lane_d[3][W], lane_inv[3][W], lane_tmax[W];
+    for(size_t i = 0; i < W; i++)
+    {
+        const Vector3& di = d[i < count ? i : 0];
+        const float c[3] = { di.x, di.y, di.z };
+        for(size_t k = 0; k < 3; k++)
+        {
+            // Axis parallel rays get a huge but finite inverse (no 0 * inf in the slab test)
+            lane_d[k][i] = c[k];
+            lane_inv[k][i] = 1.0f / (std::fabs(c[k]) > 1e-20f ? c[k] : std::copysign(1e-20f, c[k]));
+        }
+        lane_tmax[i] = i < count ? max_dist : -std::numeric_limits<float>::infinity();
+    }
+
+    const Float dx = LoadF(lane_d[0]), dy = LoadF(lane_d[1]), dz = LoadF(lane_d[2]);
+    const Float ix = LoadF(lane_inv[0]), iy = LoadF(lane_inv[1]), iz = LoadF(lane_inv[2]);
+    const Float ox = Set1F(o.x), oy = Set1F(o.y), oz = Set1F(o.z);
+    const Float tmin = Set1F(min_dist);
+    const Float zero = Set1F(0.0f);
+    const Float one = Set1F(1.0f);
+
+    Float tmax = LoadF(lane_tmax);
+    Float u = zero;
+    Float v = zero;
+    size_t primitive[W];
+    int hitLanes = 0;
+
+    // Slab test of every ray against the node box, tnear is where each ray enters it
+    auto enter = [&](const BvhHandler::Node& node, Float* tnear) {
+        const Float x0 = MulF(SubF(Set1F(node.bounds[0]), ox), ix);
+        const Float x1 = MulF(SubF(Set1F(node.bounds[1]), ox), ix);
+        const Float y0 = MulF(SubF(Set1F(node.bounds[2]), oy), iy);
+        const Float y1 = MulF(SubF(Set1F(node.bounds[3]), oy), iy);
+        const Float z0 = MulF(SubF(Set1F(node.bounds[4]), oz), iz);
+        const Float z1 = MulF(SubF(Set1F(node.bounds[5]), oz), iz);
+        const Float tn = MaxF(MaxF(MinF(x0, x1), MinF(y0, y1)), MaxF(MinF(z0, z1), tmin));
+        const Float tf = MinF(MinF(MaxF(x0, x1), MaxF(y0, y1)), MinF(MaxF(z0, z1), tmax));
+        *tnear = tn;
+        return CmpLeF(tn, tf);
+    };
+
+    // Same test as bvh::Triangle::intersect, with the origin terms shared by all the rays
+    auto intersect = [&](size_t index) {
+        const bvh::Triangle<float>& tri = triangles[index];
+        const float c[3] = { tri.p0[0] - o.x, tri.p0[1] - o.y, tri.p0[2] - o.z };
+        const float nc = tri.n[0] * c[0] + tri.n[1] * c[1] + tri.n[2] * c[2];
+
+        const Float rx = SubF(MulF(dy, Set1F(c[2])), MulF(dz, Set1F(c[1])));
+        const Float ry = SubF(MulF(dz, Set1F(c[0])), MulF(dx, Set1F(c[2])));
+        const Float rz = SubF(MulF(dx, Set1F(c[1])), MulF(dy, Set1F(c[0])));
+        auto dot = [](const bvh::Vector3<float>& a, Float x, Float y, Float z) {
+            return AddF(AddF(MulF(Set1F(a[0]), x), MulF(Set1F(a[1]), y)), MulF(Set1F(a[2]), z));
+        };
+
+        const Float invDet = DivF(one, dot(tri.n, dx, dy, dz));
+        const Float tu = MulF(dot(tri.e2, rx, ry, rz), invDet);
+        const Float tv = MulF(dot(tri.e1, rx, ry, rz), invDet);
+        const Float tw = SubF(SubF(one, tu), tv);
+        const Float t = MulF(Set1F(nc), invDet);
+
+        const Float inside = AndF(AndF(CmpGeF(tu, zero), CmpGeF(tv, zero)), CmpGeF(tw, zero));
+        const Float mask = AndF(inside, AndF(CmpGeF(t, tmin), CmpLeF(t, tmax)));
+        const int lanes = MaskF(mask);
+        if(lanes == 0) return;
+
+        tmax = SelectF(mask, t, tmax);
+        u = SelectF(mask, tu, u);
+        v = SelectF(mask, tv, v);
+        for(int bits = lanes; bits != 0; bits &= bits - 1)
+        {
+            primitive[std::countr_zero((unsigned int)bits)] = index;
+        }
+        hitLanes |= lanes;
+    };
+
+    struct Entry
+    {
+        size_t node;
+        Float  tnear;
+        Float  mask;
+    };
+    Entry stack[STACK_SIZE];
+    size_t top = 0;
+
+    Float rootNear;
+    const Float rootMask = enter(bvhHandler.nodes[0], &rootNear);
+    if(MaskF(rootMask) != 0) stack[top++] = { 0, rootNear, rootMask };
+
+    while(top > 0)
+    {
+        const Entry entry = stack[--top];
+
+        // Hits found after the push might already be closer than the node for every ray
+        if(MaskF(AndF(entry.mask, CmpLeF(entry.tnear, tmax))) == 0) continue;
+
+        const BvhHandler::Node& node = bvhHandler.nodes[entry.node];
+        if(node.is_leaf)
+        {
+            for(size_t i = 0; i < node.primitive_count; i++)
+            {
+                intersect(bvhHandler.primitive_indices[node.first_child_or_primitive + i]);
+            }
+            continue;
+        }
+
+        const size_t left = node.first_child_or_primitive;
+        const size_t right = left + 1;
+        Float nearLeft, nearRight;
+        const Float maskLeft = enter(bvhHandler.nodes[left], &nearLeft);
+        const Float maskRight = enter(bvhHandler.nodes[right], &nearRight);
+        const int bitsLeft = MaskF(maskLeft);
+        const int bitsRight = MaskF(maskRight);
+
+        if(bitsLeft != 0 && bitsRight != 0)
+        {
+            // Ordered by the first ray entering both, the nearer child is popped first
+            alignas(32) float tl[W], tr[W];
+            StoreF(tl, nearLeft);
+            StoreF(tr, nearRight);
+            const int lane = std::countr_zero((unsigned int)(bitsLeft & bitsRight));
+            const bool leftFirst = (bitsLeft & bitsRight) == 0 || tl[lane] <= tr[lane];
+
+            if(leftFirst)
+            {
+                stack[top++] = { right, nearRight, maskRight };
+                stack[top++] = { left, nearLeft, maskLeft };
+            }
+            else
+            {
+                stack[top++] = { left, nearLeft, maskLeft };
+                stack[top++] = { right, nearRight, maskRight };
+            }
+        }
+        else if(bitsLeft != 0)
+        {
+            stack[top++] = { left, nearLeft, maskLeft };
+        }
+        else if(bitsRight != 0)
+        {
+            stack[top++] = { right, nearRight, maskRight };
+        }
+    }
+
+    alignas(32) float lane_t[W], lane_u[W], lane_v[W];
+    StoreF(lane_t, tmax);
+    StoreF(lane_u, u);
+    StoreF(lane_v, v);
+    for(size_t i = 0; i < count; i++)
+    {
+        if(hitLanes & (1 << i))
+        {
+            hits[i] = ISecResult{ primitive[i], { lane_t[i], lane_u[i], lane_v[i] } };
+        }
+    }
 }
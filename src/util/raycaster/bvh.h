@@ -12,6 +12,10 @@
 #include "../../log/logger.h"
 
 #include "../../math/vector.h"
+#include "../../math/list_ops.inl"
+
+#include <vector>
+#include <optional>
 
 /* // This function builds a BVH from a vector of primitives, and intersects it with a ray.
 template <typename Primitive>
@@ -90,9 +94,11 @@ namespace Utils
         BvhTree(const float* vertices, size_t count, size_t stride, size_t offset, float sx = 1.0f, float sy = 1.0f, float sz = 1.0f);
         ~BvhTree();
 
+        // Safe to call from several threads, the traverser (and its stack) is local to every call
         inline std::optional<ISecResult> isect(const Ray& r) const
         {
-            if (auto hit = traverser->traverse(r, *primitive_intersector))
+            bvh::SingleRayTraverser<BvhHandler> traverser(bvhHandler);
+            if (auto hit = traverser.traverse(r, *primitive_intersector))
             {
 #if 1
                 auto triangle_index = hit->primitive_index;
@@ -112,9 +118,16 @@ namespace Utils
             return isect(Ray(bvh::Vector3<float>(o.x, o.y, o.z), bvh::Vector3<float>(d.x, d.y, d.z), min_dist, max_dist));
         }
 
+        // Rays sharing an origin traced together, one per SIMD lane
+        static constexpr size_t PACKET_SIZE = Math::Simd::FloatWidth;
+
+        // Closest hit of every ray from o along d[0..count), count <= PACKET_SIZE
+        // The packet walks the tree once, a node is entered when any of its rays still reaches it
+        void isectPacket(const Vector3& o, const Vector3* d, size_t count, std::optional<ISecResult>* hits, const float min_dist = 0.0f, const float max_dist = 100.0f) const;
+
     private:
         BvhHandler bvhHandler;
+        std::vector<bvh::Triangle<float>> triangles; // Referenced by the intersector
         bvh::ClosestPrimitiveIntersector<BvhHandler, bvh::Triangle<float>>* primitive_intersector = nullptr;
-        bvh::SingleRayTraverser<BvhHandler>* traverser = nullptr;
     };
 }
\ No newline at end of file
@@ -1,6 +1,9 @@
 #include "bvh.h"
 #include "../../render/nodes/mesh_node.h" // For MeshNodeData
+#include "../parallel.inl"
 #include <numbers>
+#include <numeric>
+#include <atomic>
 
 namespace Utils
 {
@@ -12,10 +15,20 @@ namespace Utils
         Vector3 new_vertex;
     };
 
-    inline std::optional<ClosestTriangleResult> TraceClosestTriangle(const int sampleCount, const Vector3& origin, const BvhTree& geometry)
+    // Ray directions shared by every traced vertex
+    // Ordered so that every packet holds nearby directions (their rays then mostly visit the same nodes)
+    struct RaycastSamples
     {
-        std::optional<ClosestTriangleResult> closestIsect = std::nullopt;
-        // Place sampleCount samples on a unit sphere around origin and create all the rays
+        std::vector<Vector3> directions;
+        std::vector<int>     sample; // Position of each direction on the sphere sequence
+    };
+
+    inline RaycastSamples MakeRaycastSamples(const int sampleCount)
+    {
+        RaycastSamples samples;
+        samples.directions.reserve(sampleCount);
+
+        // Place sampleCount samples on a unit sphere
         const float phi = std::numbers::pi_v<float> * (3.0f - sqrtf(5.0f));
         for(int s = 0; s < sampleCount; s++)
         {
@@ -24,26 +37,89 @@ namespace Utils
             float x = cosf(theta);
             float y = 1.0f - (s / ((float)sampleCount - 1.0f)) * 2.0f;
             float z = sinf(theta);
-            Vector3 direction(x, y, z);
+            samples.directions.push_back(Vector3(x, y, z));
+        }
 
-            if(auto hit = geometry.isect(origin, direction))
+        // Consecutive samples are far apart, split the set along its widest axis down to packet sized groups
+        std::vector<int> order(sampleCount);
+        std::iota(order.begin(), order.end(), 0);
+        const int W = (int)BvhTree::PACKET_SIZE;
+        std::vector<std::pair<int, int>> ranges = { { 0, sampleCount } };
+        while(!ranges.empty())
+        {
+            const auto [begin, end] = ranges.back();
+            ranges.pop_back();
+            if(end - begin <= W) continue;
+
+            Vector3 lo = samples.directions[order[begin]];
+            Vector3 hi = lo;
+            for(int i = begin; i < end; i++)
             {
-                if(closestIsect)
-                {
-                    if(hit->intersection.t < closestIsect->isect_result.intersection.t)
-                    {
-                        closestIsect = ClosestTriangleResult(hit.value(), origin + direction * hit->intersection.t);
-                    }
-                }
-                else
+                const Vector3& d = samples.directions[order[i]];
+                lo = Vector3(std::min(lo.x, d.x), std::min(lo.y, d.y), std::min(lo.z, d.z));
+                hi = Vector3(std::max(hi.x, d.x), std::max(hi.y, d.y), std::max(hi.z, d.z));
+            }
+            const Vector3 extent = hi - lo;
+            const int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : (extent.y >= extent.z ? 1 : 2);
+            auto coord = [&](int s) { const Vector3& d = samples.directions[s]; return axis == 0 ? d.x : (axis == 1 ? d.y : d.z); };
+
+            // Split on a packet boundary so only the last packet can be partial
+            const int middle = begin + std::max(1, (end - begin) / W / 2) * W;
+            std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end, [&](int a, int b) { return coord(a) < coord(b); });
+            ranges.push_back({ begin, middle });
+            ranges.push_back({ middle, end });
+        }
+
+        std::vector<Vector3> directions;
+        directions.reserve(sampleCount);
+        for(int s : order) directions.push_back(samples.directions[s]);
+        samples.directions = std::move(directions);
+        samples.sample = std::move(order);
+        return samples;
+    }
+
+    // The samples are traced in packets, ties keep the lowest sample like tracing them in sequence would
+    inline std::optional<ClosestTriangleResult> TraceClosestTriangle(const RaycastSamples& samples, const Vector3& origin, const BvhTree& geometry)
+    {
+        constexpr size_t W = BvhTree::PACKET_SIZE;
+        std::optional<ClosestTriangleResult> closestIsect = std::nullopt;
+        int closestSample = 0;
+        std::optional<BvhTree::ISecResult> hits[W];
+        for(size_t first = 0; first < samples.directions.size(); first += W)
+        {
+            const size_t count = std::min(W, samples.directions.size() - first);
+            geometry.isectPacket(origin, samples.directions.data() + first, count, hits);
+
+            for(size_t i = 0; i < count; i++)
+            {
+                const auto& hit = hits[i];
+                if(!hit) continue;
+
+                const int s = samples.sample[first + i];
+                const float t = hit->intersection.t;
+                if(!closestIsect || t < closestIsect->isect_result.intersection.t || (t == closestIsect->isect_result.intersection.t && s < closestSample))
                 {
-                    closestIsect = ClosestTriangleResult(hit.value(), origin + direction * hit->intersection.t);
+                    closestIsect = ClosestTriangleResult(hit.value(), origin + samples.directions[first + i] * t);
+                    closestSample = s;
                 }
             }
         }
         return closestIsect;
     }
 
+    // One pos + normal vertex per triangle corner
+    inline std::vector<float> ExpandIndexedMesh(const MeshNodeData& mesh)
+    {
+        std::vector<float> triangles;
+        triangles.reserve(mesh.elementCount() * 6);
+        for(size_t i = 0; i < mesh.elementCount(); i++)
+        {
+            const float* v = mesh.vertex_data + mesh.index(i) * 6;
+            triangles.insert(triangles.end(), v, v + 6);
+        }
+        return triangles;
+    }
+
     inline std::vector<BvhTree*> ConstructBvhTreesFromMeshes(std::vector<MeshNodeData> meshes, int* outParentIdx, bool adjustBounds = true)
     {
         // NOTE: This only works with meshes that are origin centered
@@ -132,7 +208,16 @@ namespace Utils
         for(int i = 0; i < (int)meshes.size(); i++)
         {
             if(i == largestMeshCountIdx) continue; // Skip the mesh with the most vertices, which will be the reference
-            ret.emplace_back(new BvhTree(meshes[i].vertex_data, meshes[i].data_size, 0, 0, scales[i].x, scales[i].y, scales[i].z));
+            if(meshes[i].indexed())
+            {
+                // The tree takes a triangle list
+                std::vector<float> triangles = ExpandIndexedMesh(meshes[i]);
+                ret.emplace_back(new BvhTree(triangles.data(), triangles.size(), 0, 0, scales[i].x, scales[i].y, scales[i].z));
+            }
+            else
+            {
+                ret.emplace_back(new BvhTree(meshes[i].vertex_data, meshes[i].data_size, 0, 0, scales[i].x, scales[i].y, scales[i].z));
+            }
         }
 
         return ret;
@@ -146,27 +231,48 @@ namespace Utils
         }
     }
 
-    // TODO: Multi-thread ray intersector
+    // Vertices handed to a thread at a time (the rays of some vertices take longer than others)
+    constexpr size_t RAYCAST_VERTEX_BLOCK = 64;
+
+    // Threads take blocks of parent vertices as they go, every result lands in the slot of its vertex
+    // Vertices without a hit are dropped, the output order is the vertex order regardless of the thread count
     inline std::vector<std::vector<Vector3>> CalculateNewRaycastVerticesIntersection(const std::vector<BvhTree*>& bvhList, const MeshNodeData& parentMesh, const int sampleCount)
     {
+        const size_t vertexCount = parentMesh.data_size / 6;
+        const size_t blocks = (vertexCount + RAYCAST_VERTEX_BLOCK - 1) / RAYCAST_VERTEX_BLOCK;
+        std::vector<Vector3> points(vertexCount);
+        std::vector<uint8_t> hits(vertexCount);
+
+        const RaycastSamples samples = MakeRaycastSamples(sampleCount);
+
         std::vector<std::vector<Vector3>> new_points_by_mesh;
         for(auto bvh : bvhList)
         {
-            static_assert(sizeof(float) * 3 == sizeof(Vector3));
-            std::vector<Vector3> new_points;
-            new_points.reserve(parentMesh.data_size / 6);
-            for(int i = 0; i < parentMesh.data_size; i += 6)
-            {
-                Vector3 vertex(parentMesh.vertex_data[i], parentMesh.vertex_data[i + 1], parentMesh.vertex_data[i + 2]);
-
-                if(auto closest_triangle = TraceClosestTriangle(sampleCount, vertex, *bvh))
+            std::atomic<size_t> next = 0;
+            ParallelTasks(std::min<size_t>(GetWorkerCount(), blocks), [&](size_t) {
+                for(size_t b = next++; b < blocks; b = next++)
                 {
-                    Vector3 new_vertex = closest_triangle->new_vertex;
-                    new_points.push_back(new_vertex);
+                    const size_t end = std::min(vertexCount, (b + 1) * RAYCAST_VERTEX_BLOCK);
+                    for(size_t v = b * RAYCAST_VERTEX_BLOCK; v < end; v++)
+                    {
+                        const float* p = parentMesh.vertex_data + v * 6;
+                        auto closest_triangle = TraceClosestTriangle(samples, Vector3(p[0], p[1], p[2]), *bvh);
+                        hits[v] = closest_triangle.has_value();
+                        if(closest_triangle)
+                        {
+                            points[v] = closest_triangle->new_vertex;
+                        }
+                    }
                 }
+            });
+
+            std::vector<Vector3> new_points;
+            new_points.reserve(std::count(hits.begin(), hits.end(), (uint8_t)1));
+            for(size_t v = 0; v < vertexCount; v++)
+            {
+                if(hits[v]) new_points.push_back(points[v]);
             }
-            new_points.shrink_to_fit();
-            new_points_by_mesh.push_back(new_points);
+            new_points_by_mesh.push_back(std::move(new_points));
         }
         return new_points_by_mesh;
     }
@@ -211,7 +211,19 @@ public:
         data.clear();
     }
 
+    // Layout version of the data being read, set by the reader (0 for data without a version)
+    inline void setVersion(unsigned int v)
+    {
+        version = v;
+    }
+
+    inline unsigned int getVersion() const
+    {
+        return version;
+    }
+
 private:
     std::vector<Byte> data;
     size_t read_offset = 0;
+    unsigned int version = 0;
 };
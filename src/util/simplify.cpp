@@ -0,0 +1,346 @@
+#include "simplify.h"
+#include "../log/logger.h"
+
+#include <unordered_map>
+#include <algorithm>
+#include <numeric>
+#include <cstring>
+#include <cmath>
+
+// Levels keeping more than this fraction of the previous level are dropped
+constexpr float LOD_MIN_REDUCTION = 0.8f;
+
+// Smallest level kept (in indices)
+constexpr size_t LOD_MIN_INDICES = 3 * 16;
+
+// Symmetric 4x4 matrix of the (area weighted) squared distance to a set of planes
+struct Quadric
+{
+    double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+    double a11 = 0, a12 = 0, a13 = 0;
+    double a22 = 0, a23 = 0;
+    double a33 = 0;
+    double w = 0;
+
+    inline void addPlane(double nx, double ny, double nz, double d, double weight)
+    {
+        a00 += weight * nx * nx; a01 += weight * nx * ny; a02 += weight * nx * nz; a03 += weight * nx * d;
+        a11 += weight * ny * ny; a12 += weight * ny * nz; a13 += weight * ny * d;
+        a22 += weight * nz * nz; a23 += weight * nz * d;
+        a33 += weight * d * d;
+        w += weight;
+    }
+
+    inline Quadric& operator+=(const Quadric& q)
+    {
+        a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+        a11 += q.a11; a12 += q.a12; a13 += q.a13;
+        a22 += q.a22; a23 += q.a23;
+        a33 += q.a33;
+        w += q.w;
+        return *this;
+    }
+
+    // Mean squared distance of p to the planes
+    inline double eval(const float* p) const
+    {
+        const double x = p[0], y = p[1], z = p[2];
+        double e = a00 * x * x + a11 * y * y + a22 * z * z
+                 + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+                 + 2.0 * (a03 * x + a13 * y + a23 * z)
+                 + a33;
+        return w > 0.0 ? std::max(e, 0.0) / w : 0.0;
+    }
+};
+
+struct PositionKey
+{
+    uint32_t bits[3];
+
+    inline bool operator==(const PositionKey& rhs) const
+    {
+        return memcmp(bits, rhs.bits, sizeof(bits)) == 0;
+    }
+};
+
+struct PositionKeyHash
+{
+    inline size_t operator()(const PositionKey& k) const
+    {
+        uint64_t h = 14695981039346656037ull;
+        for(uint32_t b : k.bits)
+        {
+            h = (h ^ b) * 1099511628211ull;
+        }
+        return (size_t)(h ^ (h >> 32));
+    }
+};
+
+static void Cross(const float* a, const float* b, const float* c, double* n)
+{
+    const double u[3] = { (double)b[0] - a[0], (double)b[1] - a[1], (double)b[2] - a[2] };
+    const double v[3] = { (double)c[0] - a[0], (double)c[1] - a[1], (double)c[2] - a[2] };
+    n[0] = u[1] * v[2] - u[2] * v[1];
+    n[1] = u[2] * v[0] - u[0] * v[2];
+    n[2] = u[0] * v[1] - u[1] * v[0];
+}
+
+std::vector<uint32_t> Utils::SimplifyMesh(const float* vertices, size_t vertexCount, size_t stride, const uint32_t* indices, size_t indexCount, size_t targetIndexCount, float* error)
+{
+    auto position = [=](uint32_t v) { return vertices + v * stride; };
+
+    // Vertices sharing a position (normal seams, every corner of a flat shaded mesh) are simplified as one
+    // Collapses and the topology go by the first vertex of each position, the corners keep their own vertex
+    std::vector<uint8_t> locked(vertexCount, 0);
+    std::vector<uint32_t> canonical(vertexCount);
+    std::vector<uint32_t> groupOffset(vertexCount + 1, 0);
+    std::vector<uint32_t> groupMembers(vertexCount);
+    {
+        std::unordered_map<PositionKey, uint32_t, PositionKeyHash> first;
+        first.reserve(vertexCount);
+        for(uint32_t v = 0; v < (uint32_t)vertexCount; v++)
+        {
+            PositionKey key;
+            memcpy(key.bits, position(v), sizeof(key.bits));
+            canonical[v] = first.try_emplace(key, v).first->second;
+            groupOffset[canonical[v] + 1]++;
+        }
+
+        std::partial_sum(groupOffset.begin(), groupOffset.end(), groupOffset.begin());
+        std::vector<uint32_t> fill(groupOffset.begin(), groupOffset.end() - 1);
+        for(uint32_t v = 0; v < (uint32_t)vertexCount; v++) groupMembers[fill[canonical[v]]++] = v;
+    }
+
+    // A corner moved onto another position takes the vertex there with the closest normal (carries the seams along)
+    const bool normals = stride >= 6;
+    auto moveCorner = [&](uint32_t v, uint32_t to) {
+        uint32_t best = to;
+        float bestDot = -INFINITY;
+        for(uint32_t k = groupOffset[to]; k < groupOffset[to + 1] && normals; k++)
+        {
+            const float* n = position(groupMembers[k]) + 3;
+            const float* m = position(v) + 3;
+            const float dot = n[0] * m[0] + n[1] * m[1] + n[2] * m[2];
+            if(dot > bestDot)
+            {
+                bestDot = dot;
+                best = groupMembers[k];
+            }
+        }
+        return best;
+    };
+
+    // Open borders are locked (an edge used by a single triangle)
+    {
+        std::unordered_map<uint64_t, uint32_t> edges;
+        edges.reserve(indexCount);
+        for(size_t i = 0; i < indexCount; i += 3)
+        {
+            for(int e = 0; e < 3; e++)
+            {
+                uint64_t a = canonical[indices[i + e]];
+                uint64_t b = canonical[indices[i + (e + 1) % 3]];
+                edges[a < b ? (a << 32 | b) : (b << 32 | a)]++;
+            }
+        }
+        for(const auto& [edge, count] : edges)
+        {
+            if(count == 1)
+            {
+                locked[(uint32_t)(edge >> 32)] = 1;
+                locked[(uint32_t)edge] = 1;
+            }
+        }
+    }
+
+    std::vector<Quadric> quadrics(vertexCount);
+    for(size_t i = 0; i < indexCount; i += 3)
+    {
+        const float* p0 = position(indices[i]);
+        double n[3];
+        Cross(p0, position(indices[i + 1]), position(indices[i + 2]), n);
+
+        const double l = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if(l <= 0.0) continue;
+
+        n[0] /= l; n[1] /= l; n[2] /= l;
+        const double d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+        for(int c = 0; c < 3; c++)
+        {
+            quadrics[canonical[indices[i + c]]].addPlane(n[0], n[1], n[2], d, l * 0.5);
+        }
+    }
+
+    struct Collapse
+    {
+        uint32_t from;
+        uint32_t to;
+        double   cost;
+    };
+
+    std::vector<uint32_t> result(indices, indices + indexCount);
+    std::vector<Collapse> candidates;
+    std::vector<uint32_t> remap(vertexCount);
+    std::vector<uint8_t> touched(vertexCount);
+    std::vector<uint32_t> adjacencyOffset(vertexCount + 1);
+    std::vector<uint32_t> adjacency;
+    double maxCost = 0.0;
+
+    while(result.size() > targetIndexCount)
+    {
+        // Both directions of every edge are considered, the cheapest allowed one is kept
+        candidates.clear();
+        for(size_t i = 0; i < result.size(); i += 3)
+        {
+            for(int e = 0; e < 3; e++)
+            {
+                const uint32_t a = canonical[result[i + e]];
+                const uint32_t b = canonical[result[i + (e + 1) % 3]];
+                if(a > b) continue; // Once per edge (interior edges are visited from both sides)
+
+                Quadric q = quadrics[a];
+                q += quadrics[b];
+                const double ab = locked[a] ? INFINITY : q.eval(position(b));
+                const double ba = locked[b] ? INFINITY : q.eval(position(a));
+                if(ab == INFINITY && ba == INFINITY) continue;
+
+                candidates.push_back(ab <= ba ? Collapse{ a, b, ab } : Collapse{ b, a, ba });
+            }
+        }
+        if(candidates.empty()) break;
+
+        std::sort(candidates.begin(), candidates.end(), [](const Collapse& l, const Collapse& r) { return l.cost < r.cost; });
+
+        // Triangles around every vertex
+        std::fill(adjacencyOffset.begin(), adjacencyOffset.end(), 0);
+        for(uint32_t v : result) adjacencyOffset[canonical[v] + 1]++;
+        std::partial_sum(adjacencyOffset.begin(), adjacencyOffset.end(), adjacencyOffset.begin());
+        adjacency.resize(result.size());
+        {
+            std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+            for(size_t i = 0; i < result.size(); i++) adjacency[fill[canonical[result[i]]]++] = (uint32_t)(i / 3);
+        }
+
+        // Every collapse removes about two triangles, touched vertices wait for the next pass
+        const size_t maxCollapses = (result.size() - targetIndexCount) / 6 + 1;
+        size_t collapses = 0;
+        std::iota(remap.begin(), remap.end(), 0u);
+        std::fill(touched.begin(), touched.end(), 0);
+
+        for(const Collapse& c : candidates)
+        {
+            if(collapses >= maxCollapses) break;
+            if(touched[c.from] || touched[c.to]) continue;
+
+            // Reject collapses that fold a remaining triangle over
+            bool flips = false;
+            const float* target = position(c.to);
+            for(uint32_t k = adjacencyOffset[c.from]; k < adjacencyOffset[c.from + 1] && !flips; k++)
+            {
+                const uint32_t* r = &result[adjacency[k] * 3];
+                const uint32_t t[3] = { canonical[r[0]], canonical[r[1]], canonical[r[2]] };
+                if(t[0] == c.to || t[1] == c.to || t[2] == c.to) continue;
+
+                const float* p[3];
+                const float* q[3];
+                for(int j = 0; j < 3; j++)
+                {
+                    p[j] = position(t[j]);
+                    q[j] = t[j] == c.from ? target : p[j];
+                }
+
+                double before[3], after[3];
+                Cross(p[0], p[1], p[2], before);
+                Cross(q[0], q[1], q[2], after);
+                const double dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+                const double lb = std::sqrt(before[0] * before[0] + before[1] * before[1] + before[2] * before[2]);
+                const double la = std::sqrt(after[0] * after[0] + after[1] * after[1] + after[2] * after[2]);
+                flips = dot <= 0.25 * lb * la;
+            }
+            if(flips) continue;
+
+            remap[c.from] = c.to;
+            quadrics[c.to] += quadrics[c.from];
+            maxCost = std::max(maxCost, c.cost);
+            collapses++;
+
+            // Every triangle around the removed vertex changes
+            for(uint32_t k = adjacencyOffset[c.from]; k < adjacencyOffset[c.from + 1]; k++)
+            {
+                const uint32_t* t = &result[adjacency[k] * 3];
+                touched[canonical[t[0]]] = touched[canonical[t[1]]] = touched[canonical[t[2]]] = 1;
+            }
+        }
+
+        if(collapses == 0) break;
+
+        size_t write = 0;
+        for(size_t i = 0; i < result.size(); i += 3)
+        {
+            uint32_t t[3];
+            for(int j = 0; j < 3; j++)
+            {
+                const uint32_t v = result[i + j];
+                t[j] = remap[canonical[v]] == canonical[v] ? v : moveCorner(v, remap[canonical[v]]);
+            }
+            if(canonical[t[0]] == canonical[t[1]] || canonical[t[1]] == canonical[t[2]] || canonical[t[0]] == canonical[t[2]]) continue;
+
+            result[write++] = t[0];
+            result[write++] = t[1];
+            result[write++] = t[2];
+        }
+        result.resize(write);
+    }
+
+    if(error != nullptr)
+    {
+        *error = (float)std::sqrt(maxCost);
+    }
+    return result;
+}
+
+Utils::IndexedLodChain Utils::BuildLodChain(const IndexedVertexData& mesh, unsigned int maxLevels)
+{
+    IndexedLodChain chain;
+    if(mesh.empty()) return chain;
+
+    std::vector<uint32_t> indices(mesh.index_count);
+    for(size_t i = 0; i < mesh.index_count; i++)
+    {
+        indices[i] = mesh.index_size == sizeof(uint16_t) ? ((const uint16_t*)mesh.indices.data())[i] : ((const uint32_t*)mesh.indices.data())[i];
+    }
+
+    const size_t vertexCount = mesh.vertices.size() / 6;
+    size_t previous = mesh.index_count;
+    for(unsigned int level = 0; level < maxLevels; level++)
+    {
+        // Simplified from the full mesh each time, so the error is against the original surface
+        const size_t target = (previous / 2) / 3 * 3;
+        if(target < LOD_MIN_INDICES) break;
+
+        float error = 0.0f;
+        std::vector<uint32_t> lod = SimplifyMesh(mesh.vertices.data(), vertexCount, 6, indices.data(), indices.size(), target, &error);
+        if(lod.size() > (size_t)(previous * LOD_MIN_REDUCTION)) break;
+
+        chain.first.push_back(chain.indices.size() / mesh.index_size);
+        chain.count.push_back(lod.size());
+        chain.error.push_back(error);
+
+        const size_t offset = chain.indices.size();
+        chain.indices.resize(offset + lod.size() * mesh.index_size);
+        if(mesh.index_size == sizeof(uint16_t))
+        {
+            uint16_t* out = (uint16_t*)(chain.indices.data() + offset);
+            for(size_t i = 0; i < lod.size(); i++) out[i] = (uint16_t)lod[i];
+        }
+        else
+        {
+            memcpy(chain.indices.data() + offset, lod.data(), lod.size() * sizeof(uint32_t));
+        }
+
+        L_DEBUG("Mesh LOD %u: %zu triangles (error %f).", level + 1, lod.size() / 3, error);
+        previous = lod.size();
+    }
+
+    return chain;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "objloader.h"
+
+namespace Utils
+{
+    // Quadric error metric edge collapse simplification of an indexed triangle mesh (Garland & Heckbert)
+    // The result indexes the same vertices, with at most targetIndexCount indices when the mesh allows it
+    // Vertices sharing a position (normal seams) move together, vertices on open borders are never moved
+    // error receives the largest collapse error as an object space distance
+    std::vector<uint32_t> SimplifyMesh(const float* vertices, size_t vertexCount, size_t stride, const uint32_t* indices, size_t indexCount, size_t targetIndexCount, float* error);
+
+    // Levels of detail of a mesh, every level has about half the triangles of the previous one
+    struct IndexedLodChain
+    {
+        std::vector<uint8_t> indices; // Every level back to back (same index size as the mesh)
+        std::vector<size_t>  first;   // First index of each level
+        std::vector<size_t>  count;
+        std::vector<float>   error;   // Object space distance error of each level
+    };
+
+    // Stops early when a level would not remove enough triangles
+    IndexedLodChain BuildLodChain(const IndexedVertexData& mesh, unsigned int maxLevels);
+}
@@ -12,13 +12,20 @@ void AnalyticsWindow::render()
     
 
     ImGui::TextColored(textColor, "framerate: %.2f", io.Framerate);
-    auto renderNode = nodeWindow->getRenderOutputNode();
-    if(renderNode)
+    const auto& renderNodes = nodeWindow->getRenderNodes();
+    if(!renderNodes.empty())
     {
-        RenderNodeData renderData = nodeWindow->getRenderOutputNode()->outputs[0]->getValue<RenderNodeData>();
-        ImGui::TextColored(textColor, "instances: %u", renderData._instanceCount);
-        ImGui::TextColored(textColor, "   motifs: %u",    renderData._motif_span);
-        ImGui::TextColored(textColor, "  objects: %u", renderData._instanceCount * renderData._motif_span);
+        unsigned int instances = 0;
+        unsigned int objects = 0;
+        for(auto renderNode : renderNodes)
+        {
+            const RenderNodeData& renderData = renderNode->outputs[0]->getValue<RenderNodeData>();
+            instances += renderData._instanceCount;
+            objects += renderData._instanceCount * renderData._motif_span;
+        }
+        ImGui::TextColored(textColor, "render nodes: %u", (unsigned int)renderNodes.size());
+        ImGui::TextColored(textColor, "instances: %u", instances);
+        ImGui::TextColored(textColor, "  objects: %u", objects);
     }
     // Camera should't be nullptr
     Renderer::Camera* camera = nodeWindow->getDrawActiveList()->camera;
@@ -4,6 +4,7 @@
 #include "../render/renderer.h"
 #include "../util/base64.h"
 #include <chrono>
+#include <limits>
 
 // TODO: Drag rectangle and clipboard select from nodes and links 
 //       (we could use serialization internally since it is already implemented, or we can copy the node data directly)
@@ -71,8 +72,11 @@ PropertyNode* NodeWindow::createNodeDynamic(const PropertyNode::Type& t)
         case PropertyNode::Type::RENDER:
         { 
             PropertyNode* newNode = new RenderNode();
-            render_output_node = newNode;
-            render_output_node_changed = true;
+            if(render_output_node == nullptr)
+            {
+                render_output_node = newNode;
+            }
+            render_nodes.push_back(newNode);
             return newNode;
         };
         case PropertyNode::Type::LIST: return new ListNode();
@@ -88,6 +92,11 @@ PropertyNode* NodeWindow::createNodeDynamic(const PropertyNode::Type& t)
         case PropertyNode::Type::MESHINTERP: return new MeshInterpolatorNode();
         case PropertyNode::Type::GRAPH: return new GraphNode();
         case PropertyNode::Type::SHADER: return new ShaderNode();
+        case PropertyNode::Type::REDUCE: return new ReduceNode();
+        case PropertyNode::Type::SLICE: return new SliceNode();
+        case PropertyNode::Type::SORT: return new SortNode();
+        case PropertyNode::Type::MESHPALETTE: return new MeshPaletteNode();
+        case PropertyNode::Type::MESHSEQUENCE: return new MeshSequenceNode();
         default: L_ERROR("Node Window deserialization encountered an invalid node type."); return nullptr;
     }
 }
@@ -632,6 +641,18 @@ void NodeWindow::render()
                     {
                         t = PropertyNode::Type::LISTJOIN;
                     }
+                    if (ImGui::MenuItem("List Slice Node"))
+                    {
+                        t = PropertyNode::Type::SLICE;
+                    }
+                    if (ImGui::MenuItem("Reduce Node"))
+                    {
+                        t = PropertyNode::Type::REDUCE;
+                    }
+                    if (ImGui::MenuItem("Sort Node"))
+                    {
+                        t = PropertyNode::Type::SORT;
+                    }
                     ImGui::EndMenu();
                 }
                 if(ImGui::BeginMenu("Mesh"))
@@ -644,6 +665,14 @@ void NodeWindow::render()
                     {
                         t = PropertyNode::Type::MESHINTERP;
                     }
+                    if (ImGui::MenuItem("Mesh Palette Node"))
+                    {
+                        t = PropertyNode::Type::MESHPALETTE;
+                    }
+                    if (ImGui::MenuItem("Mesh Sequence Node"))
+                    {
+                        t = PropertyNode::Type::MESHSEQUENCE;
+                    }
                     ImGui::EndMenu();
                 }
                 if(ImGui::BeginMenu("Misc"))
@@ -666,16 +695,7 @@ void NodeWindow::render()
                 {
                     if (ImGui::MenuItem("Render Node"))
                     {
-                        // TODO: We can allow more than one render node in fact
-                        if(render_output_node == nullptr)
-                        {
-                            t = PropertyNode::Type::RENDER;
-                        }
-                        else
-                        {
-                            L_WARNING("There can only be one render node.");
-                            t = PropertyNode::Type::INVALID;
-                        }
+                        t = PropertyNode::Type::RENDER;
                     }
                     if (ImGui::MenuItem("Camera Node"))
                     {
@@ -860,12 +880,19 @@ void NodeWindow::render()
     ImGui::EndGroup();
 }
 
+// Unversioned saves start with the node count, which is never this
+static constexpr size_t SCENE_VERSION_MARKER = std::numeric_limits<size_t>::max();
+
 // On Save to file
 // BUG: [*][ERROR]: getListData(): Received a non valid type.
 const std::string NodeWindow::serializeWindowState()
 {
     ByteBuffer buffer;
 
+    // Layout version
+    buffer.add<size_t>(SCENE_VERSION_MARKER);
+    buffer.add<unsigned int>(SCENE_VERSION_CURRENT);
+
     // Number of nodes
     buffer.add<size_t>(nodes.size());
 
@@ -894,9 +921,22 @@ void NodeWindow::deserializeWindowState(const std::string& state_string)
     ByteBuffer buffer;
     buffer.addRawData(data.data(), data.size());
 
-    // Get the number of nodes
+    // Get the number of nodes, versioned saves have a marker and the version before it
     size_t n_count = 0;
+    unsigned int version = SCENE_VERSION_UNVERSIONED;
     buffer.get(&n_count);
+    if(n_count == SCENE_VERSION_MARKER)
+    {
+        buffer.get(&version);
+        buffer.get(&n_count);
+    }
+
+    if(version > SCENE_VERSION_CURRENT)
+    {
+        L_ERROR("Save file version %u is newer than the supported version %u.", version, (unsigned int)SCENE_VERSION_CURRENT);
+        return;
+    }
+    buffer.setVersion(version);
 
     // Get the last node id
     buffer.get(&last_node_id);
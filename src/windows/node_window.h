@@ -34,6 +34,8 @@ public:
             delete n;
         }
         nodes.clear();
+        render_nodes.clear();
+        render_output_node = nullptr;
     }
 
     inline int nodeCount() const
@@ -45,20 +47,15 @@ public:
 
     PropertyNode* createNodeDynamic(const PropertyNode::Type& t);
 
+    // The first render node, it holds the scene wide settings (render mode, fog, motif)
     inline PropertyNode* getRenderOutputNode()
     {
         return render_output_node;
     }
 
-    inline bool isRenderOutputNodeChanged()
+    inline const std::vector<PropertyNode*>& getRenderNodes() const
     {
-        if(render_output_node_changed)
-        {
-            render_output_node_changed = false;
-            return true;
-        }
-
-        return false;
+        return render_nodes;
     }
 
     inline bool isFloating() const
@@ -97,10 +94,16 @@ public:
         PropertyNode* node = *(nodes.data() + idx);
         nodes.erase(nodes.begin() + idx);
 
-        // Check if it is a global render node
+        // Check if it is a render node
+        auto render_it = std::find(render_nodes.begin(), render_nodes.end(), node);
+        if(render_it != render_nodes.end())
+        {
+            render_nodes.erase(render_it);
+        }
+
         if(node == render_output_node)
         {
-            render_output_node = nullptr;
+            render_output_node = render_nodes.empty() ? nullptr : render_nodes.front();
         }
 
         // Clear the input dependencies of the node links
@@ -145,7 +148,7 @@ private:
     std::vector<PropertyNode*> nodes;
 
     PropertyNode* render_output_node = nullptr;
-    bool render_output_node_changed = false;
+    std::vector<PropertyNode*> render_nodes;
 
     ImVec2 scrolling = ImVec2(0.0f, 0.0f);
     bool show_grid = true;